@@ -38,18 +38,29 @@ void tsPrint(const char* msgFormat, ...) {
 }
 
 void printStats() {
-	for (size_t i = 0; i < getWorkerThreadCount(); ++i) {
+	for (size_t i = 0; i <= getWorkerThreadCount() + getBackgroundThreadCount(); ++i) { // main + worker threads
 		const auto stats = getThreadStats(i);
 		print("Thread %zd", i);
 #if TY_JS_PROFILE
 		print("  Total time: %.5f sec", static_cast<double>(stats.totalTime.count()) / 1e6);
 		print("  Running time: %.5f sec", static_cast<double>(stats.runningTime.count()) / 1e6);
 		print("  Idle time: %.5f sec", static_cast<double>(stats.totalTime.count() - stats.runningTime.count()) / 1e6);
+		print("    Spinning time: %.5f sec", static_cast<double>(stats.spinningTime.count()) / 1e6);
+		print("    Yielding time: %.5f sec", static_cast<double>(stats.yieldingTime.count()) / 1e6);
+		print("    Sleeping time: %.5f sec", static_cast<double>(stats.sleepingTime.count()) / 1e6);
+		print("  Max live jobs: %zd", stats.maxLiveJobs);
 #endif
 		print("  Enqueued jobs: %zd", stats.numEnqueuedJobs);
-		print("  Executed jobs: %zd", stats.numExecutedJobs);
+		print("  Executed jobs: %zd (high: %zd, normal: %zd, low: %zd, background: %zd)", stats.numExecutedJobs, stats.numExecutedJobsByPriority[0],
+		      stats.numExecutedJobsByPriority[1], stats.numExecutedJobsByPriority[2], stats.numExecutedJobsByPriority[3]);
+		print("  Job pool overflows: %zd", stats.numJobPoolOverflows);
+		print("  Spill pool overflows: %zd", stats.numSpillPoolOverflows);
+		print("  Queue overflows: %zd", stats.numQueueOverflows);
 #if TY_JS_STEALING
-		print("  Stolen jobs: %zd", stats.numStolenJobs);
+		print("  Stolen jobs: %zd (high: %zd, normal: %zd, low: %zd, background: %zd)", stats.numStolenJobs, stats.numStolenJobsByPriority[0],
+		      stats.numStolenJobsByPriority[1], stats.numStolenJobsByPriority[2], stats.numStolenJobsByPriority[3]);
+		print("  Stolen jobs by distance: shared cache: %zd, same node: %zd, remote: %zd", stats.numStolenJobsByDistance[0],
+		      stats.numStolenJobsByDistance[1], stats.numStolenJobsByDistance[2]);
 		print("  Attempted stealings: %zd", stats.numAttemptedStealings);
 		print("  Given jobs: %zd", stats.numGivenJobs);
 		print("  Stealing efficiency : %.2f %%",
@@ -6,6 +6,7 @@
 
 #include <cassert>
 #include <chrono>
+#include <new>
 #include <thread>
 
 using namespace Typhoon::Jobs;
@@ -21,28 +22,36 @@ void updateRigidBody(const JobParams& prm) {
 void jobPhysics(const JobParams& prm) {
 	tsPrint("Physics");
 	const int numRigidBodies = unpackJobArg<int>(prm.args);
+	// Start the children together
+	JobBatch batch;
 	for (int i = 0; i < numRigidBodies; ++i) {
-		const JobId childJob = createChildJob(prm.job, updateRigidBody, i);
-		startJob(childJob);
+		batch.add(createChildJob(prm.job, updateRigidBody, i));
 	}
 }
 
+// Custom allocator tracking memory. context points to the allocated size
+void* customAlloc(size_t size, size_t alignment, void* context) {
+	*static_cast<size_t*>(context) += size;
+	return ::operator new(size, std::align_val_t { alignment });
+}
+
+void customFree(void* ptr, size_t size, size_t alignment, void* context) {
+	*static_cast<size_t*>(context) -= size;
+	::operator delete(ptr, std::align_val_t { alignment });
+}
+
 } // namespace
 
 int main(int /*argc*/, char* /*argv*/[]) {
 	// Custom allocator tracking memory
 	size_t memory = 0;
-	auto   customAlloc = [&memory](size_t size) {
-        memory += size;
-        return malloc(size);
-	};
-	auto customFree = [](void* ptr) { free(ptr); };
 
 	const size_t             numWorkerThreads = std::thread::hardware_concurrency() - 1;
-	const JobSystemAllocator allocator { customAlloc, customFree };
+	const JobSystemAllocator allocator { customAlloc, customFree, &memory };
 	initJobSystem(defaultMaxJobs, numWorkerThreads, allocator);
 
 	print("Worker threads: %zd", numWorkerThreads);
+	print("Allocated memory: %zd bytes", memory);
 
 	const auto startTime = std::chrono::steady_clock::now();
 
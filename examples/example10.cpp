@@ -0,0 +1,123 @@
+// This example compares the cost of rebuilding the jobs of a frame from scratch with the cost of replaying a job graph
+// The frame is a sequence of layers of jobs, as in example4, for a total of 5000 jobs
+
+#include <jobSystem/jobGraph.h>
+#include <jobSystem/jobSystem.h>
+
+#include "common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace Typhoon::Jobs;
+
+namespace {
+
+constexpr size_t numLayers = 50;
+constexpr size_t numJobsPerLayer = 99; // plus the job starting the layer
+constexpr size_t numWorkIterations = 64;
+constexpr int    numFrames = 200;
+constexpr int    numRuns = 5;
+
+float results[numLayers][numJobsPerLayer];
+
+void work(size_t layer, size_t index) {
+	float x = results[layer][index] + static_cast<float>(index);
+	for (size_t i = 0; i < numWorkIterations; ++i) {
+		x = x * 0.999f + 1.f;
+	}
+	results[layer][index] = x;
+}
+
+void jobWork(const JobParams& prm) {
+	auto [layer, index] = unpackJobArgs<size_t, size_t>(prm.args);
+	work(layer, index);
+}
+
+// Rebuild: the job of a layer spawns the jobs of the layer, and the next layer is its continuation
+void jobLayer(const JobParams& prm) {
+	const size_t layer = unpackJobArg<size_t>(prm.args);
+	for (size_t i = 0; i < numJobsPerLayer; ++i) {
+		startJob(createChildJob(prm.job, jobWork, layer, i));
+	}
+}
+
+void rebuildFrame() {
+	const JobId rootJob = createJob();
+	const JobId firstLayerJob = createChildJob(rootJob, jobLayer, size_t { 0 });
+	JobId       layerJob = firstLayerJob;
+	for (size_t layer = 1; layer < numLayers; ++layer) {
+		layerJob = addContinuation(layerJob, jobLayer, layer);
+	}
+	startJob(firstLayerJob);
+	startAndWaitForJob(rootJob);
+}
+
+// Replay: the same frame as a graph, where each layer starts with a node following all the nodes of the previous layer
+void graphLayer(const JobParams& /*prm*/) {
+}
+
+void buildFrameGraph(JobGraph& graph) {
+	JobGraph::NodeId previousNodes[numJobsPerLayer] {};
+	for (size_t layer = 0; layer < numLayers; ++layer) {
+		const JobGraph::NodeId layerNode = graph.addNode(graphLayer);
+		for (size_t i = 0; layer > 0 && i < numJobsPerLayer; ++i) {
+			graph.addEdge(previousNodes[i], layerNode);
+		}
+		for (size_t i = 0; i < numJobsPerLayer; ++i) {
+			previousNodes[i] = graph.addNode(jobWork, layer, i);
+			graph.addEdge(layerNode, previousNodes[i]);
+		}
+	}
+	graph.compile();
+}
+
+template <typename Function>
+double measureMicrosPerFrame(Function&& function) {
+	double bestTime = 0.;
+	for (int run = 0; run < numRuns; ++run) {
+		const auto startTime = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < numFrames; ++frame) {
+			function();
+		}
+		const auto   endTime = std::chrono::steady_clock::now();
+		const double time = std::chrono::duration<double, std::micro>(endTime - startTime).count() / numFrames;
+		bestTime = run == 0 ? time : std::min(bestTime, time);
+	}
+	return bestTime;
+}
+
+} // namespace
+
+int main(int /*argc*/, char* /*argv*/[]) {
+	const size_t numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	initJobSystem(defaultMaxJobs, numWorkerThreads);
+
+	print("Jobs per frame: %zd", numLayers * (numJobsPerLayer + 1));
+	print("Worker threads: %zd", numWorkerThreads);
+
+	const double serialTime = measureMicrosPerFrame([] {
+		for (size_t layer = 0; layer < numLayers; ++layer) {
+			for (size_t i = 0; i < numJobsPerLayer; ++i) {
+				work(layer, i);
+			}
+		}
+	});
+	print("Serial:  %8.1f us per frame", serialTime);
+
+	const double rebuildTime = measureMicrosPerFrame(rebuildFrame);
+	print("Rebuild: %8.1f us per frame", rebuildTime);
+
+	JobGraph   graph;
+	const auto buildStartTime = std::chrono::steady_clock::now();
+	buildFrameGraph(graph);
+	const double buildTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - buildStartTime).count();
+	print("Graph build and compile: %8.1f us, once", buildTime);
+
+	const double replayTime = measureMicrosPerFrame([&graph] { startAndWaitForJob(createGraphJob(nullJobId, graph)); });
+	print("Replay:  %8.1f us per frame (%.2fx)", replayTime, rebuildTime / replayTime);
+
+	destroyJobSystem();
+	return 0;
+}
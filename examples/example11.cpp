@@ -0,0 +1,77 @@
+// This example measures the cost of continuations: adding many continuations to a job, and executing long chains of continuations
+
+#include <jobSystem/jobSystem.h>
+
+#include "common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace Typhoon::Jobs;
+
+namespace {
+
+constexpr int numContinuations = 4000;
+constexpr int numRuns = 20;
+
+void doNothing(const JobParams& /*prm*/) {
+}
+
+template <typename Function>
+double measureMicros(Function&& function) {
+	double bestTime = 0.;
+	for (int run = 0; run < numRuns; ++run) {
+		const auto   startTime = std::chrono::steady_clock::now();
+		const double time = function(startTime);
+		bestTime = run == 0 ? time : std::min(bestTime, time);
+	}
+	return bestTime;
+}
+
+double elapsedMicros(std::chrono::steady_clock::time_point startTime) {
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+} // namespace
+
+int main(int /*argc*/, char* /*argv*/[]) {
+	JobSystemSettings settings;
+	settings.numJobsPerThread = 8192;
+	settings.numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	initJobSystem(settings);
+
+	print("Continuations: %d", numContinuations);
+	print("Worker threads: %zd", settings.numWorkerThreads);
+
+	// Continuations of the same job
+	const double addTime = measureMicros([](auto startTime) {
+		const JobId rootJob = createJob();
+		const JobId job = createChildJob(rootJob);
+		for (int i = 0; i < numContinuations; ++i) {
+			addContinuation(job, doNothing);
+		}
+		const double time = elapsedMicros(startTime);
+		startJob(job);
+		startAndWaitForJob(rootJob);
+		return time;
+	});
+	print("Add continuations to a job: %8.1f us", addTime);
+
+	// Chain of continuations
+	const double chainTime = measureMicros([](auto startTime) {
+		const JobId rootJob = createJob();
+		const JobId firstJob = createChildJob(rootJob);
+		JobId       lastJob = firstJob;
+		for (int i = 0; i < numContinuations; ++i) {
+			lastJob = addContinuation(lastJob, doNothing);
+		}
+		startJob(firstJob);
+		startAndWaitForJob(rootJob);
+		return elapsedMicros(startTime);
+	});
+	print("Build and execute a chain:  %8.1f us, %.1f ns per continuation", chainTime, chainTime * 1000. / numContinuations);
+
+	destroyJobSystem();
+	return 0;
+}
@@ -0,0 +1,81 @@
+// This example measures the throughput of lambda jobs
+// JobLambda stores the captures in the job, while std::function allocates them on the heap once they exceed its internal storage
+
+#include <jobSystem/jobSystem.h>
+
+#include "common.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+using namespace Typhoon::Jobs;
+
+namespace {
+
+constexpr int numFrames = 100;
+constexpr int numJobsPerFrame = 2000;
+
+std::atomic<size_t> checksum;
+
+struct SmallState {
+	size_t value;
+};
+
+struct LargeState {
+	size_t values[16];
+};
+
+void consume(size_t value) {
+	checksum.fetch_add(value, std::memory_order_relaxed);
+}
+
+template <typename SubmitFunction>
+void runBenchmark(const char* name, SubmitFunction&& submit) {
+	checksum = 0;
+	const auto startTime = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < numFrames; ++frame) {
+		const JobId rootJob = createJob();
+		for (int i = 0; i < numJobsPerFrame; ++i) {
+			submit(rootJob, static_cast<size_t>(i));
+		}
+		startAndWaitForJob(rootJob);
+	}
+	const auto endTime = std::chrono::steady_clock::now();
+	const auto elapsedNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+	print("%-36s %8.1f ns/job (checksum %zd)", name, static_cast<double>(elapsedNanos) / (numFrames * numJobsPerFrame), checksum.load());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	(void)argc;
+	(void)argv;
+
+	const size_t numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	initJobSystem(defaultMaxJobs, numWorkerThreads);
+
+	print("Worker threads: %zd", numWorkerThreads);
+	print("Jobs: %d x %d", numFrames, numJobsPerFrame);
+
+	runBenchmark("JobLambda, 8 byte captures", [](JobId rootJob, size_t i) {
+		const SmallState state { i };
+		startFunction(rootJob, [state](size_t) { consume(state.value); });
+	});
+	runBenchmark("std::function, 8 byte captures", [](JobId rootJob, size_t i) {
+		const SmallState state { i };
+		startFunction(rootJob, std::function<void(size_t)> { [state](size_t) { consume(state.value); } });
+	});
+	runBenchmark("JobLambda, 128 byte captures", [](JobId rootJob, size_t i) {
+		const LargeState state { { i } };
+		startFunction(rootJob, [state](size_t) { consume(state.values[0]); });
+	});
+	runBenchmark("std::function, 128 byte captures", [](JobId rootJob, size_t i) {
+		const LargeState state { { i } };
+		startFunction(rootJob, std::function<void(size_t)> { [state](size_t) { consume(state.values[0]); } });
+	});
+
+	destroyJobSystem();
+	return 0;
+}
@@ -0,0 +1,71 @@
+// This example compares parallelReduce and parallelScan with std::accumulate and std::inclusive_scan
+
+#include <jobSystem/jobSystem.h>
+
+#include "common.h"
+
+#include <chrono>
+#include <functional>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace Typhoon::Jobs;
+
+namespace {
+
+constexpr size_t elementCount = 1 << 24;
+constexpr size_t grainSize = 1 << 14;
+constexpr int    numRuns = 10;
+
+template <typename Function>
+double measureMillis(Function&& function) {
+	double bestTime = 0.;
+	for (int run = 0; run < numRuns; ++run) {
+		const auto startTime = std::chrono::steady_clock::now();
+		function();
+		const auto   endTime = std::chrono::steady_clock::now();
+		const double time = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		bestTime = run == 0 ? time : std::min(bestTime, time);
+	}
+	return bestTime;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	(void)argc;
+	(void)argv;
+
+	const size_t numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	initJobSystem(defaultMaxJobs, numWorkerThreads);
+
+	print("Worker threads: %zd", numWorkerThreads);
+	print("Elements: %zd, grain size: %zd", elementCount, grainSize);
+
+	std::vector<int64_t> values(elementCount);
+	for (size_t i = 0; i < elementCount; ++i) {
+		values[i] = static_cast<int64_t>(i % 1024) - 512;
+	}
+	std::vector<int64_t> prefixSums(elementCount);
+
+	int64_t      serialSum = 0;
+	const double accumulateTime = measureMillis([&] { serialSum = std::accumulate(values.begin(), values.end(), int64_t { 0 }); });
+	int64_t      parallelSum = 0;
+	const double reduceTime = measureMillis([&] {
+		auto reduce = [&values](size_t begin, size_t end, int64_t init) { return std::accumulate(values.data() + begin, values.data() + end, init); };
+		startAndWaitForJob(parallelReduce(nullJobId, 0, elementCount, grainSize, int64_t { 0 }, reduce, std::plus<int64_t> {}, &parallelSum));
+	});
+	print("std::accumulate:     %8.3f ms", accumulateTime);
+	print("parallelReduce:      %8.3f ms (%.2fx)%s", reduceTime, accumulateTime / reduceTime, parallelSum == serialSum ? "" : " MISMATCH");
+
+	const double  inclusiveScanTime = measureMillis([&] { std::inclusive_scan(values.begin(), values.end(), prefixSums.begin()); });
+	const int64_t lastPrefixSum = prefixSums.back();
+	auto          scan = [&] { startAndWaitForJob(parallelScan(nullJobId, values.data(), prefixSums.data(), elementCount, grainSize, std::plus<int64_t> {})); };
+	const double  scanTime = measureMillis(scan);
+	print("std::inclusive_scan: %8.3f ms", inclusiveScanTime);
+	print("parallelScan:        %8.3f ms (%.2fx)%s", scanTime, inclusiveScanTime / scanTime, prefixSums.back() == lastPrefixSum ? "" : " MISMATCH");
+
+	destroyJobSystem();
+	return 0;
+}
@@ -0,0 +1,72 @@
+// This example compares parallelSort with std::sort on 64 bit keys, with an increasing number of threads
+
+#include <jobSystem/jobSystem.h>
+
+#include "common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace Typhoon::Jobs;
+
+namespace {
+
+constexpr size_t keyCount = 1 << 24;
+constexpr size_t grainSize = 1 << 14;
+constexpr int    numRuns = 5;
+
+void generateKeys(std::vector<uint64_t>& keys) {
+	uint64_t seed = 0x9E3779B97F4A7C15ull;
+	for (uint64_t& key : keys) {
+		// xorshift64
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+		key = seed;
+	}
+}
+
+template <typename SortFunction>
+double measureMillis(std::vector<uint64_t>& keys, SortFunction&& sort) {
+	double bestTime = 0.;
+	for (int run = 0; run < numRuns; ++run) {
+		generateKeys(keys);
+		const auto startTime = std::chrono::steady_clock::now();
+		sort();
+		const auto   endTime = std::chrono::steady_clock::now();
+		const double time = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		bestTime = run == 0 ? time : std::min(bestTime, time);
+	}
+	return bestTime;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	(void)argc;
+	(void)argv;
+
+	std::vector<uint64_t> keys(keyCount);
+	std::vector<uint64_t> scratch(keyCount); // no allocations while sorting
+
+	print("Keys: %zd, grain size: %zd", keyCount, grainSize);
+	const double sortTime = measureMillis(keys, [&keys] { std::sort(keys.begin(), keys.end()); });
+	print("std::sort:                  %8.2f ms", sortTime);
+
+	const size_t maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (size_t numThreads = 1;; numThreads = std::min(numThreads * 2, maxThreads)) {
+		initJobSystem(defaultMaxJobs, numThreads - 1);
+		const double parallelSortTime = measureMillis(keys, [&keys, &scratch] {
+			startAndWaitForJob(parallelSort(nullJobId, keys.begin(), keys.end(), grainSize, std::less<> {}, scratch.data()));
+		});
+		const bool sorted = std::is_sorted(keys.begin(), keys.end());
+		print("parallelSort, %2zd thread(s): %8.2f ms (%.2fx)%s", numThreads, parallelSortTime, sortTime / parallelSortTime, sorted ? "" : " NOT SORTED");
+		destroyJobSystem();
+		if (numThreads == maxThreads) {
+			break;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,102 @@
+// This example blurs an image with multiple threads, comparing a loop over rows with a loop over 2D tiles
+// Based on example5
+
+#include <jobSystem/jobSystem.h>
+
+#include "common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace Typhoon::Jobs;
+
+namespace {
+
+constexpr int    blurRadius = 2;
+constexpr size_t tileSizeX = 256;
+constexpr size_t tileSizeY = 32;
+constexpr int    numRuns = 5;
+
+struct Image {
+	size_t             width;
+	size_t             height;
+	std::vector<float> data;
+};
+
+void fillImage(Image& image) {
+	for (size_t y = 0; y < image.height; ++y) {
+		for (size_t x = 0; x < image.width; ++x) {
+			image.data[y * image.width + x] = static_cast<float>((x * 7 + y * 13) % 256);
+		}
+	}
+}
+
+// Box blur of a block of the destination image
+void blur(const Image& src, Image& dst, size_t beginX, size_t endX, size_t beginY, size_t endY) {
+	constexpr float weight = 1.f / ((2 * blurRadius + 1) * (2 * blurRadius + 1));
+	const int       width = static_cast<int>(src.width);
+	const int       height = static_cast<int>(src.height);
+	for (size_t y = beginY; y < endY; ++y) {
+		for (size_t x = beginX; x < endX; ++x) {
+			float sum = 0.f;
+			for (int dy = -blurRadius; dy <= blurRadius; ++dy) {
+				const int sy = std::clamp(static_cast<int>(y) + dy, 0, height - 1);
+				for (int dx = -blurRadius; dx <= blurRadius; ++dx) {
+					const int sx = std::clamp(static_cast<int>(x) + dx, 0, width - 1);
+					sum += src.data[sy * src.width + sx];
+				}
+			}
+			dst.data[y * dst.width + x] = sum * weight;
+		}
+	}
+}
+
+template <typename Function>
+double measureMillis(Function&& function) {
+	double bestTime = 0.;
+	for (int run = 0; run < numRuns; ++run) {
+		const auto startTime = std::chrono::steady_clock::now();
+		function();
+		const auto   endTime = std::chrono::steady_clock::now();
+		const double time = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		bestTime = run == 0 ? time : std::min(bestTime, time);
+	}
+	return bestTime;
+}
+
+} // namespace
+
+int main(int /*argc*/, char* /*argv*/[]) {
+	constexpr size_t width = 4096;
+	constexpr size_t height = 4096;
+
+	Image src { width, height, std::vector<float>(width * height) };
+	Image dst { width, height, std::vector<float>(width * height) };
+	fillImage(src);
+
+	const size_t numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	initJobSystem(defaultMaxJobs, numWorkerThreads);
+
+	print("Image: %zd x %zd, blur radius: %d", width, height, blurRadius);
+	print("Worker threads: %zd", numWorkerThreads);
+
+	const double stTime = measureMillis([&] { blur(src, dst, 0, width, 0, height); });
+	print("Singlethreaded:        %8.2f ms", stTime);
+
+	const double rowsTime = measureMillis([&] {
+		auto body = [&](size_t beginY, size_t endY) { blur(src, dst, 0, width, beginY, endY); };
+		startAndWaitForJob(parallelFor(nullJobId, 0, height, tileSizeY, body));
+	});
+	print("parallelFor over rows: %8.2f ms (%.2fx)", rowsTime, stTime / rowsTime);
+
+	const double tilesTime = measureMillis([&] {
+		auto body = [&](size_t beginX, size_t endX, size_t beginY, size_t endY) { blur(src, dst, beginX, endX, beginY, endY); };
+		startAndWaitForJob(parallelFor2D(nullJobId, width, height, tileSizeX, tileSizeY, body));
+	});
+	print("parallelFor2D, %zdx%zd: %8.2f ms (%.2fx)", tileSizeX, tileSizeY, tilesTime, stTime / tilesTime);
+
+	destroyJobSystem();
+	return 0;
+}
@@ -18,15 +18,50 @@ constexpr size_t defaultMaxJobs = 4096;
 
 constexpr size_t maxThreads = 64;
 constexpr size_t defaultParallelForSplitThreshold = 256; // TODO elements or bytes?
+// Size of a cache line, used to avoid false sharing
+constexpr size_t cacheLineSize = 64;
 // Default sleep time in microsecond for idle threads
 constexpr int sleep_us = 1;
+// Default number of iterations an idle thread spins, executing a pause instruction, while looking for jobs
+constexpr unsigned defaultIdleSpinCount = 256;
+// Default number of iterations an idle thread yields its time slice, after spinning and before going to sleep
+constexpr unsigned defaultIdleYieldCount = 16;
+// Default number of jobs a thread takes, higher priorities first, before giving precedence to a lower priority
+constexpr unsigned defaultPriorityStarvationLimit = 16;
 
 // Alignment of the Job structure
 // The padding bytes are used to hold data for the associated Job function
+// Set to 64 for compact, single cache line jobs. Arguments that do not fit in a job are stored in a spill block
 #ifndef TY_JS_JOB_ALIGNMENT
 #define TY_JS_JOB_ALIGNMENT 256
 #endif
 
+// Size of a spill block, holding the arguments of a job that do not fit in the Job structure
+#ifndef TY_JS_SPILL_BLOCK_SIZE
+#define TY_JS_SPILL_BLOCK_SIZE 256
+#endif
+
+// Default number of spill blocks per thread
+constexpr size_t defaultSpillBlocksPerThread = 256;
+
+// Number of jobs a JobBatch holds before starting them
+constexpr size_t jobBatchCapacity = 64;
+
+// Maximum size of the captures of a JobLambda
+// With the default job alignment, a JobLambda fits in the job itself
+#ifdef TY_JS_LAMBDA_CAPTURE_SIZE
+constexpr size_t jobLambdaCaptureSize = (TY_JS_LAMBDA_CAPTURE_SIZE);
+#else
+constexpr size_t jobLambdaCaptureSize = 176;
+#endif
+
+// Set to 1 to use 64 bit job identifiers, made of a 32 bit job index and a 32 bit generation
+// The job capacity is then no longer limited to 65534 jobs, and identifiers of recycled jobs are detected
+// Set to 0 to use compact 16 bit job identifiers
+#ifndef TY_JS_WIDE_JOB_ID
+#define TY_JS_WIDE_JOB_ID 0
+#endif
+
 // Set to 0 to disable job stealing
 #ifndef TY_JS_STEALING
 #define TY_JS_STEALING 1
@@ -1,9 +1,20 @@
 #pragma once
 
+#include "config.h"
 #include <cstdint>
 
 namespace Typhoon {
 
+namespace Jobs {
+
+#if TY_JS_WIDE_JOB_ID
+using JobId = uint64_t;
+#else
 using JobId = uint16_t;
+#endif
+
+} // namespace Jobs
+
+using JobId = Jobs::JobId;
 
 }
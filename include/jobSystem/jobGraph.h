@@ -0,0 +1,122 @@
+/**
+ * @file
+ *
+ * Static graph of jobs, built once and launched every frame.
+ */
+
+#pragma once
+
+#include "jobSystem.h"
+#include <atomic>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Typhoon {
+
+namespace Jobs {
+
+/**
+ * @brief Job graph
+
+Directed acyclic graph of job functions, each executed after all of its predecessors. The graph is built once with addNode and
+addEdge, then compiled into flat arrays of nodes and successors with precomputed predecessor counts. Launching the compiled graph
+with createGraphJob only resets the predecessor counters: the arguments of the nodes are packed once, when they are added.
+Ready nodes are executed by runner jobs, at most one per thread, which take them from a queue of the graph: launching the graph
+creates a few jobs, not one per node. The thread finishing a node continues with its first ready successor, without going through
+the queue.
+*/
+class JobGraph {
+public:
+	using NodeId = uint32_t;
+
+	/**
+	 * @brief Add a node executing a function with arguments
+	 The function receives the arguments in JobParams::args, as a job created with createJob, and the graph job in JobParams::job
+	 * @param function node function
+	 * @param ...args function arguments, copied into the graph
+	 * @return node identifier
+	 */
+	template <typename... ArgType>
+	NodeId addNode(JobFunction function, ArgType... args);
+
+	/**
+	 * @brief Make a node execute after another one
+	 * @param predecessor node executed first
+	 * @param successor node executed after the predecessor has returned
+	 */
+	void addEdge(NodeId predecessor, NodeId successor);
+
+	/**
+	 * @brief Compile the graph, which must be acyclic, so that it can be launched
+	 Adding nodes or edges to a compiled graph requires compiling it again
+	 */
+	void compile();
+
+	bool isCompiled() const {
+		return compiled;
+	}
+
+	size_t getNodeCount() const {
+		return nodes.size();
+	}
+
+private:
+	struct Node {
+		JobFunction function;
+		uint32_t    argOffset;        // in args
+		uint32_t    firstSuccessor;   // in successors
+		uint32_t    successorCount;
+		uint32_t    predecessorCount; // initial value of the pending counter
+	};
+
+	friend JobId createGraphJob(JobId parentJobId, JobGraph& graph);
+
+	NodeId      addNodeImpl(JobFunction function, const void* data, size_t dataSize);
+	void        startRunners(size_t pushedNodeCount);
+	void        pushReadyNode(NodeId node);
+	NodeId      popReadyNode();
+	void        runNodes(size_t threadIndex);
+	static void graphJobFunction(const JobParams& prm);
+	static void runnerJob(const JobParams& prm);
+
+	std::vector<Node>                       nodes;
+	std::vector<std::pair<NodeId, NodeId>>  edges;                          // predecessor, successor
+	std::vector<char>                       args;
+	std::vector<NodeId>                     successors;                     // of each node, contiguous
+	std::vector<NodeId>                     roots;                          // nodes with no predecessors
+	std::unique_ptr<std::atomic_uint32_t[]> pendingCounts;                  // predecessors of each node yet to finish
+	std::unique_ptr<std::atomic<NodeId>[]>  readyNodes;                     // queue of the nodes ready to execute
+	std::atomic_uint32_t                    readyPushIndex { 0 };           // in readyNodes
+	std::atomic_uint32_t                    readyPopIndex { 0 };            // in readyNodes
+	std::atomic_uint32_t                    runnerCount { 0 };              // running runner jobs. The last one releases the graph job
+	uint32_t                                maxRunnerCount = 0;             // one per thread
+	JobId                                   graphJob = nullJobId;           // job executing the graph
+	JobPriority                             priority = JobPriority::normal; // of the graph job, given to the runner jobs
+	bool                                    compiled = false;
+};
+
+/**
+ * @brief Create a job executing a compiled job graph
+ The job resets the graph and starts its nodes, with its own priority, and finishes after all the nodes. Do not modify or launch
+ the graph again before the job has finished. Successors of a node start when its function returns, while child jobs of
+ JobParams::job created by the node only delay the completion of the graph job
+ * @param parentJobId parent job identifier
+ * @param graph compiled graph
+ * @return graph job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
+ */
+JobId createGraphJob(JobId parentJobId, JobGraph& graph);
+
+template <typename... ArgType>
+JobGraph::NodeId JobGraph::addNode(JobFunction function, ArgType... args) {
+	static_assert((std::is_trivially_copyable_v<ArgType> && ... && true));
+
+	auto argTuple = std::make_tuple(args...);
+	return addNodeImpl(function, &argTuple, sizeof argTuple);
+}
+
+} // namespace Jobs
+
+} // namespace Typhoon
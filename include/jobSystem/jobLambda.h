@@ -0,0 +1,95 @@
+/**
+ * @file
+ *
+ * Move-only callable stored in place in a job.
+ */
+
+#pragma once
+
+#include "config.h"
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Typhoon {
+
+namespace Jobs {
+
+/**
+ * @brief Job lambda
+
+Move-only callable with signature void(size_t threadIndex). Unlike std::function, the captures are always stored in place and never
+allocated on the heap. Captures larger than jobLambdaCaptureSize are rejected at compile time.
+*/
+class JobLambda {
+public:
+	template <typename Callable, typename = std::enable_if_t<! std::is_same_v<std::decay_t<Callable>, JobLambda>>>
+	JobLambda(Callable&& callable);
+	JobLambda(JobLambda&& other) noexcept;
+	JobLambda(const JobLambda&) = delete;
+	JobLambda& operator=(const JobLambda&) = delete;
+	JobLambda& operator=(JobLambda&&) = delete;
+	~JobLambda();
+
+	void operator()(size_t threadIndex);
+
+private:
+	using InvokeFunction = void (*)(void* callable, size_t threadIndex);
+	using ManageFunction = void (*)(void* dst, void* src); // move constructs dst from src, or destroys dst if src is null
+
+	template <typename Callable>
+	static void invokeCallable(void* callable, size_t threadIndex);
+	template <typename Callable>
+	static void manageCallable(void* dst, void* src);
+
+	alignas(std::max_align_t) char storage[jobLambdaCaptureSize];
+	InvokeFunction invoke;
+	ManageFunction manage;
+};
+
+template <typename Callable, typename>
+JobLambda::JobLambda(Callable&& callable) {
+	using CallableType = std::decay_t<Callable>;
+	static_assert(std::is_invocable_v<CallableType&, size_t>, "A job lambda must be callable with a thread index");
+	static_assert(sizeof(CallableType) <= sizeof storage, "Lambda captures are too large. Capture a pointer or increase TY_JS_LAMBDA_CAPTURE_SIZE");
+	static_assert(alignof(CallableType) <= alignof(std::max_align_t), "Lambda captures are over-aligned");
+	static_assert(std::is_move_constructible_v<CallableType>);
+
+	new (storage) CallableType { std::forward<Callable>(callable) };
+	invoke = invokeCallable<CallableType>;
+	manage = manageCallable<CallableType>;
+}
+
+inline JobLambda::JobLambda(JobLambda&& other) noexcept
+    : invoke(other.invoke)
+    , manage(other.manage) {
+	manage(storage, other.storage);
+}
+
+inline JobLambda::~JobLambda() {
+	manage(storage, nullptr);
+}
+
+inline void JobLambda::operator()(size_t threadIndex) {
+	invoke(storage, threadIndex);
+}
+
+template <typename Callable>
+void JobLambda::invokeCallable(void* callable, size_t threadIndex) {
+	(*static_cast<Callable*>(callable))(threadIndex);
+}
+
+template <typename Callable>
+void JobLambda::manageCallable(void* dst, void* src) {
+	if (src) {
+		new (dst) Callable { std::move(*static_cast<Callable*>(src)) };
+	}
+	else {
+		static_cast<Callable*>(dst)->~Callable();
+	}
+}
+
+} // namespace Jobs
+
+} // namespace Typhoon
@@ -7,9 +7,14 @@
 #pragma once
 
 #include "config.h"
+#include "fwdDecl.h"
+#include "jobLambda.h"
 #include <cstdint>
 #include <functional>
+#include <iterator>
 #include <tuple>
+#include <type_traits>
+#include <vector>
 #if TY_JS_PROFILE
 #include <chrono>
 #endif
@@ -18,7 +23,6 @@ namespace Typhoon {
 
 namespace Jobs {
 
-using JobId = uint16_t;
 constexpr JobId nullJobId = 0;
 
 struct JobSystem;
@@ -40,10 +44,17 @@ struct JobParams {
  */
 using JobFunction = void (*)(const JobParams&);
 
-/**
- * @brief Job lambda
- */
-using JobLambda = std::function<void(size_t threadIndex)>;
+namespace detail {
+
+// A callable that is not a JobFunction, invocable with the given arguments
+template <typename Callable, typename... ArgType>
+constexpr bool isJobCallable = ! std::is_convertible_v<std::decay_t<Callable>, JobFunction> &&
+                               std::is_invocable_v<std::decay_t<Callable>&, std::decay_t<ArgType>&&...>;
+
+template <typename Callable, typename... ArgType>
+using EnableIfJobCallable = std::enable_if_t<isJobCallable<Callable, ArgType...>, JobId>;
+
+} // namespace detail
 
 /**
  * @brief Parallel for function.
@@ -52,15 +63,114 @@ using ParallelForFunction = void (*)(size_t elementCount, size_t splitThreshold,
 
 /**
  * @brief Custom allocator
+ alloc returns a block of size bytes aligned to alignment, a power of two, or nullptr on failure
+ free receives the size and the alignment of the block. context is passed to both functions
  */
 struct JobSystemAllocator {
-	std::function<void*(size_t)> alloc;
-	std::function<void(void*)>   free;
+	void* (*alloc)(size_t size, size_t alignment, void* context);
+	void (*free)(void* ptr, size_t size, size_t alignment, void* context);
+	void* context = nullptr;
+};
+
+/**
+ * @brief Memory backing the job pool
+ With huge pages, fewer TLB entries cover the pool. The pool is pre-faulted by initJobSystem in any case
+ */
+enum class JobPoolMemory {
+	allocator,    // allocated with the job system allocator
+	hugePages,    // mapped with transparent huge pages (Linux). Falls back to the allocator
+	hugeTlbPages, // mapped with MAP_HUGETLB from the huge pages reserved by the system (Linux). Falls back to transparent huge pages
 };
 
 // Pass this to initJobSystem to let the library initialize the number of worker threads
 constexpr size_t defaultNumWorkerThreads = (size_t)-1;
 
+/**
+ * @brief What to do when a thread creates a job and all the jobs in its pool are in use
+ With either policy job creation can return nullJobId. startJob, startJobs, waitForJob, addContinuation and addDependency reject
+ nullJobId, so the job is then lost: check the result of the creation if the work must be done
+ */
+enum class JobPoolOverflowPolicy {
+	executePendingJobs, // execute pending jobs until a job of the pool finishes. Fail if there are no pending jobs
+	fail,               // job creation functions return nullJobId
+};
+
+/**
+ * @brief How parallelFor splits a range of elements into jobs
+ */
+enum class ParallelForSplitMode {
+	eager, // recursively split the range in halves down to the split threshold, creating about 2N/threshold jobs
+	lazy,  // process the range in chunks of splitThreshold elements and split off half of the rest only when the local queue is empty
+};
+
+/**
+ * @brief Priority of a job
+ Each thread queue holds one deque per priority. Threads pop and steal jobs of higher priority first
+ Jobs have normal priority by default. Child jobs inherit the priority of their parent, continuations the priority of the job they follow
+ Background jobs are long-running or blocking jobs, executed by background worker threads only. Their continuations have normal priority
+ */
+enum class JobPriority : uint8_t {
+	high,
+	normal,
+	low,
+	background, // executed by background worker threads only, low priority if there are none
+};
+
+// Number of job priorities
+constexpr size_t jobPriorityCount = 4;
+
+/**
+ * @brief Distance between a thread and the victim of a steal in the memory hierarchy
+ Threads steal from the closest victims first. Without pinning (see JobSystemSettings) all victims are on the same node
+ */
+enum class StealDistance : uint8_t {
+	sharedCache, // threads sharing the last level cache
+	sameNode,    // threads on the same NUMA node
+	remote,      // threads on another NUMA node
+};
+
+// Number of steal distances
+constexpr size_t stealDistanceCount = 3;
+
+/**
+ * @brief Job system settings
+ An idle thread first spins looking for jobs, then yields its time slice, then goes to sleep until a job is pushed
+ */
+struct JobSystemSettings {
+	size_t   numJobsPerThread = defaultMaxJobs;          // maximum number of jobs that a worker thread can execute
+	size_t   numWorkerThreads = defaultNumWorkerThreads; // number of worker threads
+	size_t   numBackgroundThreads = 0;                   // number of worker threads executing background jobs, in addition to numWorkerThreads
+	unsigned idleSpinCount = defaultIdleSpinCount;       // iterations spent spinning by an idle thread
+	unsigned idleYieldCount = defaultIdleYieldCount;     // iterations spent yielding by an idle thread
+	bool     stealHalf = true;                           // a thief moves half of the jobs of the victim to its own queue
+	JobPoolOverflowPolicy jobPoolOverflowPolicy = JobPoolOverflowPolicy::executePendingJobs;
+	size_t                spillBlocksPerThread = defaultSpillBlocksPerThread; // blocks for the arguments that do not fit in a job
+	ParallelForSplitMode  parallelForSplitMode = ParallelForSplitMode::eager;
+	// After this many jobs a thread looks for lower priority jobs first, so that they are not starved. 0 to disable
+	unsigned priorityStarvationLimit = defaultPriorityStarvationLimit;
+	// Pin each worker thread to a CPU, and steal from threads sharing the cache, then from threads on the same NUMA node
+	// The topology is read from /sys/devices/system/cpu. Linux only, ignored on other platforms
+	bool pinThreads = false;
+	// With pinThreads, CPU of each worker thread, background worker threads included. Used even if the topology cannot be read
+	// By default worker threads are spread over the CPUs closest to the one running the main thread
+	std::vector<int> workerCpus;
+	// Memory backing the job pool. Use getJobPoolMemory to know which memory was actually used
+	JobPoolMemory jobPoolMemory = JobPoolMemory::allocator;
+};
+
+/**
+ * @brief Initialize the job system with custom settings and a custom allocator
+ * @param settings settings
+ * @param allocator
+ */
+void initJobSystem(const JobSystemSettings& settings, const JobSystemAllocator& allocator);
+
+/**
+ * @brief Initialize the job system with custom settings and the default allocator (aligned operator new and delete)
+ * @param settings settings
+ */
+void initJobSystem(const JobSystemSettings& settings);
+
 /**
  * @brief Initialize the job system with a custom allocator
  * @param numJobsPerThread maximum number of jobs that a worker thread can execute
@@ -70,7 +180,7 @@ constexpr size_t defaultNumWorkerThreads = (size_t)-1;
 void initJobSystem(size_t numJobsPerThread, size_t numWorkerThreads, const JobSystemAllocator& allocator);
 
 /**
- * @brief Initialize the job system with the default allocator (malloc and free)
+ * @brief Initialize the job system with the default allocator (aligned operator new and delete)
  * @param numJobsPerThread maximum number of jobs that a worker thread can execute
  * @param numWorkerThreads number of worker threads. Pass defaultNumWorkerThreads as default
  */
@@ -81,15 +191,28 @@ void initJobSystem(size_t numJobsPerThread, size_t numWorkerThreads);
  */
 void destroyJobSystem();
 
+/**
+ * @brief Return the memory actually backing the job pool, which can differ from the requested one
+ * @return job pool memory
+ */
+JobPoolMemory getJobPoolMemory();
+
 /**
  * @brief Return the number of worker threads
- * @return number of worker threads
+ * @return number of worker threads, background worker threads excluded
  */
 size_t getWorkerThreadCount();
 
+/**
+ * @brief Return the number of background worker threads
+ Their indices follow the ones of the worker threads
+ * @return number of background worker threads
+ */
+size_t getBackgroundThreadCount();
+
 /**
  * @brief Create an empty job
- * @return job identifier
+ * @return job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
  */
 JobId createJob();
 
@@ -97,38 +220,124 @@ JobId createJob();
  * @brief Create a job executing a function with arguments
  * @param function function associated with the job
  * @param ...args function arguments
- * @return new job identifier
+ * @return new job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
  */
 template <typename... ArgType>
 JobId createJob(JobFunction function, ArgType... args);
 
+/**
+ * @brief Create a job executing any callable with arguments
+ The callable and the arguments are moved into the job, and the callable is invoked directly as callable(args...)
+ They are destroyed after the invocation
+ * @param callable callable associated with the job, e.g. a lambda or a function object
+ * @param ...args callable arguments
+ * @return new job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
+ */
+template <typename Callable, typename... ArgType>
+detail::EnableIfJobCallable<Callable, ArgType...> createJob(Callable&& callable, ArgType&&... args);
+
 /**
  * @brief Create a child job executing a function with no arguments
+ The creation fails if all the jobs of the pool of the calling thread are in use, even with JobPoolOverflowPolicy::executePendingJobs
+ when the thread has no pending job to execute, e.g. because the jobs in use have not been started yet
  * @param parentJobId parent job identifier
  * @param function function associated with the job
- * @return new job identifier
+ * @return new job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
  */
 JobId createChildJob(JobId parentJobId, JobFunction function = nullptr);
 
 /**
  * @brief Create a child job executing a function with arguments
+ The creation can fail as with the other createChildJob overloads
  * @tparam ...ArgType
  * @param parentJobId parent job identifier
  * @param function function associated with the job
  * @param ...args
- * @return new job identifier
+ * @return new job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
  */
 template <typename... ArgType>
 JobId createChildJob(JobId parentJobId, JobFunction function, ArgType... args);
 
+/**
+ * @brief Create a child job executing any callable with arguments
+ The callable and the arguments are moved into the job, and the callable is invoked directly as callable(args...)
+ The creation can fail as with the other createChildJob overloads
+ * @param parentJobId parent job identifier
+ * @param callable callable associated with the job
+ * @param ...args callable arguments
+ * @return new job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
+ */
+template <typename Callable, typename... ArgType>
+detail::EnableIfJobCallable<Callable, ArgType...> createChildJob(JobId parentJobId, Callable&& callable, ArgType&&... args);
+
+/**
+ * @brief Create a job with a priority
+ * @param priority job priority
+ * @param ...args arguments of one of the other createJob overloads
+ * @return new job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
+ */
+template <typename... ArgType>
+JobId createJob(JobPriority priority, ArgType&&... args);
+
+/**
+ * @brief Create a child job with a priority, instead of the priority of its parent
+ * @param parentJobId parent job identifier
+ * @param priority job priority
+ * @param ...args arguments of one of the other createChildJob overloads, after the parent
+ * @return new job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
+ */
+template <typename... ArgType>
+JobId createChildJob(JobId parentJobId, JobPriority priority, ArgType&&... args);
+
 /**
  * @brief Start a job
- * @param jobId job identifier
+ * @param jobId job identifier. nullJobId, returned by a failed creation, is rejected
  */
 void startJob(JobId jobId);
 
+/**
+ * @brief Start several jobs at once
+ The jobs must have been created by the calling thread. They are published to the other threads together, and as many sleeping
+ workers are woken up as there are jobs, instead of one per job
+ * @param jobIds job identifiers. nullJobId, returned by a failed creation, is rejected
+ * @param count number of jobs
+ */
+void startJobs(const JobId* jobIds, size_t count);
+
+/**
+ * @brief Job batch
+
+Collects jobs created by the calling thread and starts them together with startJobs, when the batch is full, flushed or destroyed.
+*/
+class JobBatch {
+public:
+	JobBatch() = default;
+	JobBatch(const JobBatch&) = delete;
+	JobBatch& operator=(const JobBatch&) = delete;
+	~JobBatch();
+
+	/**
+	 * @brief Add a job to the batch
+	 Null identifiers, returned by a full job pool, are ignored
+	 * @param jobId job identifier
+	 */
+	void add(JobId jobId);
+
+	/**
+	 * @brief Start the jobs added so far
+	 */
+	void flush();
+
+private:
+	JobId  jobIds[jobBatchCapacity];
+	size_t count = 0;
+};
+
 /**
  * @brief Wait for a job to complete
+ Any thread can wait for any job. The threads of the job system execute pending jobs while waiting, then sleep until the job
+ completes. Other threads, such as a render thread, sleep right away. With 16 bit job identifiers, the wait must start before
+ the job is recycled by its creator, which cannot be detected (see TY_JS_WIDE_JOB_ID)
  * @param jobId job identifier
  */
 void waitForJob(JobId jobId);
@@ -141,6 +350,7 @@ void startAndWaitForJob(JobId jobId);
 
 /**
  * @brief Create and start a child job executing a lambda function
+ If the job pool is full (see JobPoolOverflowPolicy), the lambda is executed immediately by the calling thread
  * @param parentJobId parent job identifier
  * @param lambda lambda function
  */
@@ -150,7 +360,7 @@ void startFunction(JobId parentJobId, JobLambda&& lambda);
  * @brief Add a continuation to a job, with no arguments
  * @param job previous job identifier
  * @param function function associated with the continuation
- * @return continuation identifier
+ * @return continuation identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
  */
 JobId addContinuation(JobId job, JobFunction function);
 
@@ -159,22 +369,42 @@ JobId addContinuation(JobId job, JobFunction function);
  * @param job previous job identifier
  * @param function function associated with the continuation
  * @param ...args function arguments
- * @return continuation identifier
+ * @return continuation identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
  */
 template <typename... ArgType>
 JobId addContinuation(JobId job, JobFunction function, ArgType... args);
 
+/**
+ * @brief Add a continuation to a job, executing any callable with arguments
+ * @param job previous job identifier
+ * @param callable callable associated with the continuation
+ * @param ...args callable arguments
+ * @return continuation identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
+ */
+template <typename Callable, typename... ArgType>
+detail::EnableIfJobCallable<Callable, ArgType...> addContinuation(JobId job, Callable&& callable, ArgType&&... args);
+
 /**
  * @brief Add a lambda continuation to a job
- Note: prefer lambdas with few captures to avoid heap allocations
  * @param jobId previous job identifier
  * @param lambda lambda associated with the continuation
- * @return continuation identifier
+ * @return continuation identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
 */
 JobId addContinuation(JobId jobId, JobLambda&& lambda);
 
+/**
+ * @brief Make a job wait for another job, in addition to its other predecessors
+ A job with predecessors is started automatically by the thread finishing the last one, and must not be started with startJob.
+ Unlike a continuation, the job keeps its parent. Add all the dependencies before starting the predecessors
+ * @param jobId job identifier
+ * @param predecessorId identifier of a job that has not been started yet
+ * @return false if the job pool is full (see JobPoolOverflowPolicy). Each dependency takes a job until the predecessor finishes
+ */
+bool addDependency(JobId jobId, JobId predecessorId);
+
 /**
  * @brief Helper: create and start a child job executing a function with arguments
+ If the job pool is full (see JobPoolOverflowPolicy), the function is executed immediately by the calling thread
  * @param parentJobId parent job identifier
  * @param function function associated with the job
  * @param ...args function arguments
@@ -184,16 +414,108 @@ void startChildJob(JobId parentJobId, JobFunction function, ArgType... args);
 
 /**
  * @brief Execute a parallel for loop
+ The range is split into jobs according to JobSystemSettings::parallelForSplitMode
  * @param parentJobId parent job identifier
  * @param elementCount element count
  * @param splitThreshold split threshold used to break the loop into threads, in elements
  * @param function associated with the job
  * @param ...args  function arguments
- * @return
+ * @return loop job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
  */
 template <typename... ArgType>
 JobId parallelFor(JobId parentJobId, size_t splitThreshold, ParallelForFunction function, size_t elementCount, const ArgType&... args);
 
+/**
+ * @brief Execute a parallel for loop over the range [begin, end), calling a callable on subranges
+ The range is split into jobs according to JobSystemSettings::parallelForSplitMode
+ The body is moved into the loop job and shared by all the jobs of the loop, so it can capture any state
+ * @param parentJobId parent job identifier
+ * @param begin first element index
+ * @param end one past the last element index
+ * @param grainSize minimum number of elements processed by a job. Rounded up to a multiple of chunkAlignment
+ * @param body callable with signature void(size_t begin, size_t end) or void(size_t begin, size_t end, size_t threadIndex)
+ * @param chunkAlignment subranges start at multiples of this number of elements, except the first one. Use e.g. cacheLineSize / sizeof(element)
+ to prevent threads from writing to the same cache line
+ * @return loop job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
+ */
+template <typename Body>
+JobId parallelFor(JobId parentJobId, size_t begin, size_t end, size_t grainSize, Body&& body, size_t chunkAlignment = 1);
+
+/**
+ * @brief Execute a parallel for loop over a 2D grid, divided into tiles
+ The grid is split in halves along its longest axis, measured in tiles, until each job processes a single tile
+ * @param parentJobId parent job identifier
+ * @param sizeX number of columns
+ * @param sizeY number of rows
+ * @param tileSizeX tile width
+ * @param tileSizeY tile height
+ * @param body callable with signature void(size_t beginX, size_t endX, size_t beginY, size_t endY), optionally followed by size_t threadIndex
+ * @return loop job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
+ */
+template <typename Body>
+JobId parallelFor2D(JobId parentJobId, size_t sizeX, size_t sizeY, size_t tileSizeX, size_t tileSizeY, Body&& body);
+
+/**
+ * @brief Execute a parallel for loop over a 3D grid, divided into tiles
+ The grid is split in halves along its longest axis, measured in tiles, until each job processes a single tile
+ * @param parentJobId parent job identifier
+ * @param sizeX, sizeY, sizeZ grid size
+ * @param tileSizeX, tileSizeY, tileSizeZ tile size
+ * @param body callable with signature void(size_t beginX, size_t endX, size_t beginY, size_t endY, size_t beginZ, size_t endZ), optionally
+ followed by size_t threadIndex
+ * @return loop job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
+ */
+template <typename Body>
+JobId parallelFor3D(JobId parentJobId, size_t sizeX, size_t sizeY, size_t sizeZ, size_t tileSizeX, size_t tileSizeY, size_t tileSizeZ, Body&& body);
+
+/**
+ * @brief Execute a parallel reduction over the range [begin, end)
+ The range is split in halves down to grainSize elements. Each subrange is reduced by a job and the results are combined
+ pairwise by continuations, in a tree that preserves the order of the subranges
+ * @param parentJobId parent job identifier
+ * @param begin first element index
+ * @param end one past the last element index
+ * @param grainSize maximum number of elements reduced by a job
+ * @param identity identity value of combine, e.g. 0 for a sum
+ * @param reduce callable with signature T(size_t begin, size_t end, const T& init), reducing a subrange starting from init
+ * @param combine associative callable with signature T(T left, T right)
+ * @param result receives the result of the reduction once the returned job has finished
+ * @return reduction job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
+ */
+template <typename T, typename Reduce, typename Combine>
+JobId parallelReduce(JobId parentJobId, size_t begin, size_t end, size_t grainSize, T identity, Reduce&& reduce, Combine&& combine, T* result);
+
+/**
+ * @brief Execute a parallel inclusive scan (e.g. a prefix sum)
+ The input is divided into blocks of grainSize elements. A first parallel pass scans each block, a serial step combines
+ the block sums and a second parallel pass adds them to the blocks
+ * @param parentJobId parent job identifier
+ * @param input input elements
+ * @param output output elements. Can be the same as input
+ * @param count number of elements
+ * @param grainSize number of elements in a block
+ * @param combine associative callable with signature T(T left, T right)
+ * @return scan job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
+ */
+template <typename T, typename Combine>
+JobId parallelScan(JobId parentJobId, const T* input, T* output, size_t count, size_t grainSize, Combine&& combine);
+
+/**
+ * @brief Sort a range in parallel with a merge sort
+ The range is split in halves down to grainSize elements, which are sorted with std::sort. Sorted halves are merged by a
+ parallel merge, alternating between the range and a scratch buffer. The sort is not stable
+ * @param parentJobId parent job identifier
+ * @param first first element
+ * @param last one past the last element
+ * @param grainSize maximum number of elements sorted or merged by a job
+ * @param compare comparison function, as for std::sort
+ * @param scratch optional buffer of last - first elements. If null, a buffer is allocated when the sort job starts
+ * @return sort job identifier, or nullJobId if the job pool is full (see JobPoolOverflowPolicy)
+ */
+template <typename RandomIt, typename Compare = std::less<>>
+JobId parallelSort(JobId parentJobId, RandomIt first, RandomIt last, size_t grainSize, Compare&& compare = {},
+                   typename std::iterator_traits<RandomIt>::value_type* scratch = nullptr);
+
 /**
  * @brief Utility to unpack arguments
  * @param args pointer to a buffer containing arguments
@@ -205,14 +527,25 @@ std::tuple<ArgType...> unpackJobArgs(const void* args);
 struct ThreadStats {
 	size_t numEnqueuedJobs;
 	size_t numExecutedJobs;
+	size_t numExecutedJobsByPriority[jobPriorityCount];
+	size_t numJobPoolOverflows;   // number of times the thread pool was full when creating a job
+	size_t numSpillPoolOverflows; // number of times the thread spill pool was full when creating a job
+	size_t numQueueOverflows;     // number of times the job queue was full, so that a started job was executed immediately or waited for room
 #if TY_JS_STEALING
 	size_t numStolenJobs;
+	size_t numStolenJobsByPriority[jobPriorityCount];
+	size_t numStolenJobsByDistance[stealDistanceCount]; // by distance of the victim
 	size_t numAttemptedStealings;
 	size_t numGivenJobs;
 #endif
 #if TY_JS_PROFILE
+	size_t                    maxLiveJobs; // high-water mark of the jobs in use in the thread pool. Use it to tune numJobsPerThread
 	std::chrono::microseconds totalTime;
 	std::chrono::microseconds runningTime;
+	// Idle time spent in each phase
+	std::chrono::microseconds spinningTime;
+	std::chrono::microseconds yieldingTime;
+	std::chrono::microseconds sleepingTime;
 #endif
 };
 
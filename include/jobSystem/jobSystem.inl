@@ -1,6 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
 #include <cstring>
+#include <iterator>
+#include <new>
+#include <utility>
+#include <vector>
 
 namespace Typhoon {
 
@@ -8,9 +16,14 @@ namespace Jobs {
 
 namespace detail {
 
-JobId createJobImpl(JobFunction function, const void* data = nullptr, size_t dataSize = 0);
-JobId createChildJobImpl(JobId parent, JobFunction function, const void* data = nullptr, size_t dataSize = 0);
-JobId addContinuationImpl(JobId job, JobFunction function, const void* data, size_t dataSize);
+JobId       createJobImpl(JobFunction function, const void* data = nullptr, size_t dataSize = 0);
+JobId       createChildJobImpl(JobId parent, JobFunction function, const void* data = nullptr, size_t dataSize = 0);
+JobId       addContinuationImpl(JobId job, JobFunction function, const void* data, size_t dataSize);
+void        setJobPriorityImpl(JobId jobId, JobPriority priority);
+JobPriority getJobPriorityImpl(JobId jobId);
+// Keeps a started job unfinished until releaseJobImpl is called, by any thread
+void retainJobImpl(JobId jobId);
+void releaseJobImpl(JobId jobId);
 
 struct ParallelForJobData {
 	ParallelForFunction function;
@@ -21,6 +34,87 @@ struct ParallelForJobData {
 };
 
 void parallelForImpl(const JobParams& prm);
+void* getJobDataImpl(JobId jobId);
+
+template <typename Callable, typename... ArgType>
+using CallableTuple = std::tuple<std::decay_t<Callable>, std::decay_t<ArgType>...>;
+
+// Storage reserved in a job for a callable tuple, which is aligned in place
+template <typename Tuple>
+constexpr size_t callableStorageSize = sizeof(Tuple) + alignof(Tuple) - 1;
+
+template <typename Tuple>
+Tuple* getCallableTuple(const void* jobData) {
+	const uintptr_t address = reinterpret_cast<uintptr_t>(jobData);
+	const uintptr_t alignedAddress = (address + alignof(Tuple) - 1) & ~(alignof(Tuple) - 1);
+	return reinterpret_cast<Tuple*>(alignedAddress);
+}
+
+// Job function generated for each callable tuple type: invokes the callable with the stored arguments, then destroys them
+template <typename Tuple>
+void invokeCallableTuple(const JobParams& prm) {
+	Tuple* const tuple = getCallableTuple<Tuple>(prm.args);
+	std::apply([](auto& callable, auto&... args) { std::invoke(callable, std::move(args)...); }, *tuple);
+	tuple->~Tuple();
+}
+
+// Moves a callable and its arguments into a job created for a callable tuple
+template <typename Tuple, typename Callable, typename... ArgType>
+JobId emplaceCallableTuple(JobId jobId, Callable&& callable, ArgType&&... args) {
+	if (jobId) {
+		new (getCallableTuple<Tuple>(getJobDataImpl(jobId))) Tuple { std::forward<Callable>(callable), std::forward<ArgType>(args)... };
+	}
+	return jobId;
+}
+
+template <typename Tuple>
+constexpr bool checkCallableTuple() {
+	static_assert(callableStorageSize<Tuple> <= TY_JS_SPILL_BLOCK_SIZE, "The callable and its arguments are too large");
+	return true;
+}
+
+// Type-erased state of a parallel loop over a range, shared by all of its jobs
+struct RangeLoop {
+	void (*invoke)(RangeLoop& loop, size_t begin, size_t end, size_t threadIndex);
+	void (*destroy)(RangeLoop& loop);
+	size_t             begin;
+	size_t             end;
+	size_t             grainSize;
+	size_t             chunkAlignment;
+	std::atomic_size_t pendingRangeCount; // ranges being processed. The last one destroys the body
+};
+
+template <typename Body>
+struct RangeLoopWithBody : RangeLoop {
+	Body body;
+};
+
+void runRangeLoop(RangeLoop& loop, JobId job, size_t begin, size_t end, size_t threadIndex);
+void rangeLoopJob(const JobParams& prm);
+
+template <typename Body>
+void invokeRangeLoopBody(RangeLoop& loop, size_t begin, size_t end, size_t threadIndex) {
+	Body& body = static_cast<RangeLoopWithBody<Body>&>(loop).body;
+	if constexpr (std::is_invocable_v<Body&, size_t, size_t, size_t>) {
+		body(begin, end, threadIndex);
+	}
+	else {
+		(void)threadIndex;
+		body(begin, end);
+	}
+}
+
+template <typename Body>
+void destroyRangeLoop(RangeLoop& loop) {
+	static_cast<RangeLoopWithBody<Body>&>(loop).~RangeLoopWithBody<Body>();
+}
+
+// Job function of the root job of a parallel loop, holding the loop state
+template <typename Body>
+void rangeLoopRootJob(const JobParams& prm) {
+	RangeLoop& loop = *getCallableTuple<RangeLoopWithBody<Body>>(prm.args);
+	runRangeLoop(loop, prm.job, loop.begin, loop.end, prm.threadIndex);
+}
 
 } // namespace detail
 
@@ -29,7 +123,16 @@ JobId createJob(JobFunction function, ArgType... args) {
 	static_assert((std::is_trivially_copyable_v<ArgType> && ... && true));
 
 	auto argTuple = std::make_tuple(args...);
-	return createJobImpl(function, &argTuple, sizeof argTuple);
+	return detail::createJobImpl(function, &argTuple, sizeof argTuple);
+}
+
+template <typename Callable, typename... ArgType>
+detail::EnableIfJobCallable<Callable, ArgType...> createJob(Callable&& callable, ArgType&&... args) {
+	using Tuple = detail::CallableTuple<Callable, ArgType...>;
+	static_assert(detail::checkCallableTuple<Tuple>());
+
+	const JobId jobId = detail::createJobImpl(detail::invokeCallableTuple<Tuple>, nullptr, detail::callableStorageSize<Tuple>);
+	return detail::emplaceCallableTuple<Tuple>(jobId, std::forward<Callable>(callable), std::forward<ArgType>(args)...);
 }
 
 template <typename... ArgType>
@@ -40,10 +143,44 @@ JobId createChildJob(JobId parentJobId, JobFunction function, ArgType... args) {
 	return detail::createChildJobImpl(parentJobId, function, &argTuple, sizeof argTuple);
 }
 
+template <typename Callable, typename... ArgType>
+detail::EnableIfJobCallable<Callable, ArgType...> createChildJob(JobId parentJobId, Callable&& callable, ArgType&&... args) {
+	using Tuple = detail::CallableTuple<Callable, ArgType...>;
+	static_assert(detail::checkCallableTuple<Tuple>());
+
+	const JobId jobId = detail::createChildJobImpl(parentJobId, detail::invokeCallableTuple<Tuple>, nullptr, detail::callableStorageSize<Tuple>);
+	return detail::emplaceCallableTuple<Tuple>(jobId, std::forward<Callable>(callable), std::forward<ArgType>(args)...);
+}
+
+template <typename... ArgType>
+JobId createJob(JobPriority priority, ArgType&&... args) {
+	const JobId jobId = createJob(std::forward<ArgType>(args)...);
+	if (jobId) {
+		detail::setJobPriorityImpl(jobId, priority);
+	}
+	return jobId;
+}
+
+template <typename... ArgType>
+JobId createChildJob(JobId parentJobId, JobPriority priority, ArgType&&... args) {
+	const JobId jobId = createChildJob(parentJobId, std::forward<ArgType>(args)...);
+	if (jobId) {
+		detail::setJobPriorityImpl(jobId, priority);
+	}
+	return jobId;
+}
+
 template <typename... ArgType>
 void startChildJob(JobId parentJobId, JobFunction function, ArgType... args) {
-	JobId job = createChildJob(parentJobId, function, args...);
-	startJob(job);
+	if (JobId job = createChildJob(parentJobId, function, args...); job) {
+		startJob(job);
+	}
+	else {
+		// The job pool is full. Execute the function on this thread
+		const auto      argTuple = std::make_tuple(args...);
+		const JobParams prm { parentJobId, getThisThreadIndex(), &argTuple };
+		function(prm);
+	}
 }
 
 template <typename... ArgType>
@@ -54,6 +191,15 @@ JobId addContinuation(JobId job, JobFunction function, ArgType... args) {
 	return detail::addContinuationImpl(job, function, &argTuple, sizeof argTuple);
 }
 
+template <typename Callable, typename... ArgType>
+detail::EnableIfJobCallable<Callable, ArgType...> addContinuation(JobId job, Callable&& callable, ArgType&&... args) {
+	using Tuple = detail::CallableTuple<Callable, ArgType...>;
+	static_assert(detail::checkCallableTuple<Tuple>());
+
+	const JobId continuationId = detail::addContinuationImpl(job, detail::invokeCallableTuple<Tuple>, nullptr, detail::callableStorageSize<Tuple>);
+	return detail::emplaceCallableTuple<Tuple>(continuationId, std::forward<Callable>(callable), std::forward<ArgType>(args)...);
+}
+
 template <typename... ArgType>
 JobId parallelFor(JobId parent, size_t splitThreshold, ParallelForFunction function, size_t elementCount, const ArgType&... args) {
 	static_assert((std::is_trivially_copyable_v<ArgType> && ... && true));
@@ -66,6 +212,521 @@ JobId parallelFor(JobId parent, size_t splitThreshold, ParallelForFunction funct
 	return detail::createChildJobImpl(parent, detail::parallelForImpl, &jobData, sizeof jobData);
 }
 
+template <typename Body>
+JobId parallelFor(JobId parentJobId, size_t begin, size_t end, size_t grainSize, Body&& body, size_t chunkAlignment) {
+	using Loop = detail::RangeLoopWithBody<std::decay_t<Body>>;
+	static_assert(detail::checkCallableTuple<Loop>());
+	assert(begin <= end);
+	assert(chunkAlignment > 0);
+
+	const JobId jobId =
+	    detail::createChildJobImpl(parentJobId, detail::rangeLoopRootJob<std::decay_t<Body>>, nullptr, detail::callableStorageSize<Loop>);
+	if (jobId) {
+		Loop* const loop = new (detail::getCallableTuple<Loop>(detail::getJobDataImpl(jobId))) Loop { {}, std::forward<Body>(body) };
+		loop->invoke = detail::invokeRangeLoopBody<std::decay_t<Body>>;
+		loop->destroy = detail::destroyRangeLoop<std::decay_t<Body>>;
+		loop->begin = begin;
+		loop->end = end;
+		loop->grainSize = grainSize;
+		loop->chunkAlignment = chunkAlignment;
+		loop->pendingRangeCount = 1;
+	}
+	return jobId;
+}
+
+namespace detail {
+
+// Reference to the state of a parallel algorithm, shared by its jobs. The last reference destroys the state
+template <typename State>
+class SharedStateReference {
+public:
+	explicit SharedStateReference(State* state)
+	    : state(state) {
+		state->referenceCount.fetch_add(1, std::memory_order_relaxed);
+	}
+	SharedStateReference(SharedStateReference&& other) noexcept
+	    : state(std::exchange(other.state, nullptr)) {
+	}
+	SharedStateReference(const SharedStateReference&) = delete;
+	SharedStateReference& operator=(const SharedStateReference&) = delete;
+	SharedStateReference& operator=(SharedStateReference&&) = delete;
+	~SharedStateReference() {
+		if (state && state->referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			state->~State();
+		}
+	}
+
+	// Takes over a reference detached with release
+	static SharedStateReference adopt(State* state) {
+		SharedStateReference reference { state };
+		state->referenceCount.fetch_sub(1, std::memory_order_relaxed);
+		return reference;
+	}
+	// Detaches the reference, e.g. to pass it to a job as a trivially copyable argument
+	State* release() {
+		return std::exchange(state, nullptr);
+	}
+	SharedStateReference share() const {
+		return SharedStateReference { state };
+	}
+	State* get() const {
+		return state;
+	}
+	State* operator->() const {
+		return state;
+	}
+
+private:
+	State* state;
+};
+
+// Returns the callable stored in a job created with a callable and no arguments
+template <typename Callable>
+Callable* getStoredCallable(JobId jobId) {
+	return &std::get<0>(*getCallableTuple<CallableTuple<Callable>>(getJobDataImpl(jobId)));
+}
+
+// Constructs the state of a parallel algorithm in the data of its root job
+template <typename State, typename... ArgType>
+JobId createStateJob(JobId parentJobId, JobFunction function, ArgType&&... args) {
+	static_assert(checkCallableTuple<State>());
+	const JobId jobId = createChildJobImpl(parentJobId, function, nullptr, callableStorageSize<State>);
+	if (jobId) {
+		new (getCallableTuple<State>(getJobDataImpl(jobId))) State { std::forward<ArgType>(args)... };
+	}
+	return jobId;
+}
+
+template <typename T, typename Reduce, typename Combine>
+struct ReduceState {
+	using ValueType = T;
+
+	Reduce             reduce;
+	Combine            combine;
+	T                  identity;
+	T*                 result;
+	size_t             begin;
+	size_t             end;
+	size_t             grainSize;
+	std::atomic_size_t referenceCount = 0;
+};
+
+// Continuation combining the results of the two halves of a range
+template <typename State>
+struct ReduceCombine {
+	using T = typename State::ValueType;
+
+	SharedStateReference<State> state;
+	T*                          result;
+	T                           left;
+	T                           right;
+
+	void operator()() {
+		*result = state->combine(std::move(left), std::move(right));
+	}
+};
+
+template <typename State>
+void reduceRange(SharedStateReference<State> state, JobId job, typename State::ValueType* result, size_t begin, size_t end);
+
+template <typename State>
+void reduceRangeJob(const JobParams& prm) {
+	auto [state, result, begin, end] = unpackJobArgs<State*, typename State::ValueType*, size_t, size_t>(prm.args);
+	reduceRange(SharedStateReference<State>::adopt(state), prm.job, result, begin, end);
+}
+
+template <typename State>
+void spawnReduceRange(const SharedStateReference<State>& state, JobId parentJobId, typename State::ValueType* result, size_t begin, size_t end) {
+	if (JobId job = createChildJob(parentJobId, reduceRangeJob<State>, state.get(), result, begin, end); job) {
+		state.share().release(); // adopted by the job
+		startJob(job);
+	}
+	else {
+		// The job pool is full. Reduce the range on this thread
+		reduceRange(state.share(), parentJobId, result, begin, end);
+	}
+}
+
+// Reduces a range into result. Large ranges are split in halves reduced by child jobs of a join job,
+// whose continuation combines the two results
+template <typename State>
+void reduceRange(SharedStateReference<State> state, JobId job, typename State::ValueType* result, size_t begin, size_t end) {
+	if (end - begin > state->grainSize) {
+		if (const JobId joinJob = createChildJob(job); joinJob) {
+			const JobId combineJob = addContinuation(joinJob, ReduceCombine<State> { state.share(), result, state->identity, state->identity });
+			if (combineJob) {
+				ReduceCombine<State>& combine = *getStoredCallable<ReduceCombine<State>>(combineJob);
+				const size_t          middle = begin + (end - begin) / 2;
+				spawnReduceRange(state, joinJob, &combine.left, begin, middle);
+				spawnReduceRange(state, joinJob, &combine.right, middle, end);
+				startJob(joinJob);
+				return;
+			}
+			startJob(joinJob);
+		}
+		// The job pool is full. Reduce the range on this thread
+	}
+	*result = state->reduce(begin, end, state->identity);
+}
+
+template <typename State>
+void reduceRootJob(const JobParams& prm) {
+	State* const state = getCallableTuple<State>(prm.args);
+	reduceRange(SharedStateReference<State> { state }, prm.job, state->result, state->begin, state->end);
+}
+
+template <typename T, typename Combine>
+struct ScanState {
+	using ValueType = T;
+
+	Combine            combine;
+	const T*           input;
+	T*                 output;
+	size_t             count;
+	size_t             blockSize;
+	std::atomic_size_t referenceCount = 0;
+
+	size_t getBlockCount() const {
+		return (count + blockSize - 1) / blockSize;
+	}
+	size_t getBlockEnd(size_t block) const {
+		return std::min((block + 1) * blockSize, count);
+	}
+	// First pass: inclusive scan of each block on its own
+	void scanBlocks(size_t firstBlock, size_t lastBlock) {
+		for (size_t block = firstBlock; block < lastBlock; ++block) {
+			const size_t blockBegin = block * blockSize;
+			output[blockBegin] = input[blockBegin];
+			for (size_t i = blockBegin + 1, blockEnd = getBlockEnd(block); i < blockEnd; ++i) {
+				output[i] = combine(output[i - 1], input[i]);
+			}
+		}
+	}
+	// Serial step: turn the last element of each block into the inclusive scan of all blocks up to it
+	void scanBlockSums() {
+		for (size_t block = 1, blockCount = getBlockCount(); block < blockCount; ++block) {
+			const size_t last = getBlockEnd(block) - 1;
+			output[last] = combine(output[block * blockSize - 1], output[last]);
+		}
+	}
+	// Second pass: add the sum of the previous blocks to the elements of each block, except the last one
+	void addBlockOffsets(size_t firstBlock, size_t lastBlock) {
+		for (size_t block = std::max<size_t>(firstBlock, 1); block < lastBlock; ++block) {
+			const size_t blockBegin = block * blockSize;
+			const T      offset = output[blockBegin - 1];
+			for (size_t i = blockBegin, last = getBlockEnd(block) - 1; i < last; ++i) {
+				output[i] = combine(offset, output[i]);
+			}
+		}
+	}
+};
+
+template <typename State>
+void scanBlockSumsJob(const JobParams& prm) {
+	SharedStateReference<State> state = SharedStateReference<State>::adopt(std::get<0>(unpackJobArgs<State*>(prm.args)));
+	state->scanBlockSums();
+	const size_t blockCount = state->getBlockCount();
+	auto         body = [state = state.share()](size_t firstBlock, size_t lastBlock) { state->addBlockOffsets(firstBlock, lastBlock); };
+	if (const JobId secondPass = parallelFor(prm.job, 0, blockCount, 1, std::move(body)); secondPass) {
+		startJob(secondPass);
+	}
+	else {
+		// The job pool is full. Run the second pass on this thread
+		state->addBlockOffsets(0, blockCount);
+	}
+}
+
+template <typename State>
+void scanRootJob(const JobParams& prm) {
+	SharedStateReference<State> state { getCallableTuple<State>(prm.args) };
+	const size_t                blockCount = state->getBlockCount();
+	auto                        body = [state = state.share()](size_t firstBlock, size_t lastBlock) { state->scanBlocks(firstBlock, lastBlock); };
+	const JobId                 firstPass = parallelFor(prm.job, 0, blockCount, 1, std::move(body));
+	if (! firstPass) {
+		// The job pool is full. Scan on this thread
+		state->scanBlocks(0, blockCount);
+		state->scanBlockSums();
+		state->addBlockOffsets(0, blockCount);
+		return;
+	}
+	if (! addContinuation(firstPass, scanBlockSumsJob<State>, state.get())) {
+		startJob(firstPass);
+		waitForJob(firstPass);
+		state->scanBlockSums();
+		state->addBlockOffsets(0, blockCount);
+		return;
+	}
+	state.share().release(); // adopted by the continuation
+	startJob(firstPass);
+}
+
+template <typename RandomIt, typename Compare>
+struct SortState {
+	using ValueType = typename std::iterator_traits<RandomIt>::value_type;
+
+	Compare                compare;
+	RandomIt               first;
+	ValueType*             scratch;
+	size_t                 count;
+	size_t                 grainSize;
+	std::vector<ValueType> allocatedScratch {}; // used if no scratch buffer is provided
+	std::atomic_size_t     referenceCount = 0;
+};
+
+template <typename State>
+void mergeRanges(SharedStateReference<State> state, JobId job, size_t first0, size_t count0, size_t first1, size_t count1, size_t dst, bool toScratch);
+
+template <typename State>
+void mergeRangesJob(const JobParams& prm) {
+	auto [state, first0, count0, first1, count1, dst, toScratch] = unpackJobArgs<State*, size_t, size_t, size_t, size_t, size_t, bool>(prm.args);
+	mergeRanges(SharedStateReference<State>::adopt(state), prm.job, first0, count0, first1, count1, dst, toScratch);
+}
+
+// Merges two sorted ranges, given as offsets in the source buffer, into the destination buffer
+// toScratch: the source is the sorted array and the destination is the scratch buffer, or vice versa
+// Large merges are split around the median of the larger range, located in the other range with a binary search
+template <typename State>
+void mergeRanges(SharedStateReference<State> state, JobId job, size_t first0, size_t count0, size_t first1, size_t count1, size_t dst, bool toScratch) {
+	auto merge = [&state, job, toScratch](size_t firstA, size_t countA, size_t firstB, size_t countB, size_t dstOffset, auto src, auto dstIt) {
+		if (countA + countB <= state->grainSize) {
+			std::merge(std::make_move_iterator(src + firstA), std::make_move_iterator(src + firstA + countA), std::make_move_iterator(src + firstB),
+			           std::make_move_iterator(src + firstB + countB), dstIt + dstOffset, state->compare);
+			return;
+		}
+		if (countA < countB) {
+			std::swap(firstA, firstB);
+			std::swap(countA, countB);
+		}
+		const size_t middleA = countA / 2;
+		const size_t middleB = std::lower_bound(src + firstB, src + firstB + countB, src[firstA + middleA], state->compare) - (src + firstB);
+		dstIt[dstOffset + middleA + middleB] = std::move(src[firstA + middleA]);
+
+		auto spawn = [&state, job, toScratch](size_t f0, size_t c0, size_t f1, size_t c1, size_t d) {
+			if (JobId child = createChildJob(job, mergeRangesJob<State>, state.get(), f0, c0, f1, c1, d, toScratch); child) {
+				state.share().release(); // adopted by the job
+				startJob(child);
+			}
+			else {
+				// The job pool is full. Merge on this thread
+				mergeRanges(state.share(), job, f0, c0, f1, c1, d, toScratch);
+			}
+		};
+		spawn(firstA, middleA, firstB, middleB, dstOffset);
+		spawn(firstA + middleA + 1, countA - middleA - 1, firstB + middleB, countB - middleB, dstOffset + middleA + middleB + 1);
+	};
+	if (toScratch) {
+		merge(first0, count0, first1, count1, dst, state->first, state->scratch);
+	}
+	else {
+		merge(first0, count0, first1, count1, dst, state->scratch, state->first);
+	}
+}
+
+template <typename State>
+void sortRange(SharedStateReference<State> state, JobId job, size_t first, size_t count, bool toScratch);
+
+template <typename State>
+void sortRangeJob(const JobParams& prm) {
+	auto [state, first, count, toScratch] = unpackJobArgs<State*, size_t, size_t, bool>(prm.args);
+	sortRange(SharedStateReference<State>::adopt(state), prm.job, first, count, toScratch);
+}
+
+template <typename State>
+void mergeSortedHalvesJob(const JobParams& prm) {
+	auto [state, first, count, toScratch] = unpackJobArgs<State*, size_t, size_t, bool>(prm.args);
+	const size_t half = count / 2;
+	// The halves were sorted into the other buffer
+	mergeRanges(SharedStateReference<State>::adopt(state), prm.job, first, half, first + half, count - half, first, toScratch);
+}
+
+// Sorts a range, given as an offset and a count, leaving the result in the array or in the scratch buffer
+// Large ranges are split in halves sorted into the other buffer by child jobs of a join job, whose continuation merges them back
+template <typename State>
+void sortRange(SharedStateReference<State> state, JobId job, size_t first, size_t count, bool toScratch) {
+	if (count > state->grainSize) {
+		if (const JobId joinJob = createChildJob(job); joinJob) {
+			if (addContinuation(joinJob, mergeSortedHalvesJob<State>, state.get(), first, count, toScratch)) {
+				state.share().release(); // adopted by the continuation
+				auto spawn = [&state, joinJob, toScratch](size_t childFirst, size_t childCount) {
+					if (JobId child = createChildJob(joinJob, sortRangeJob<State>, state.get(), childFirst, childCount, ! toScratch); child) {
+						state.share().release(); // adopted by the job
+						startJob(child);
+					}
+					else {
+						// The job pool is full. Sort on this thread
+						sortRange(state.share(), joinJob, childFirst, childCount, ! toScratch);
+					}
+				};
+				const size_t half = count / 2;
+				spawn(first, half);
+				spawn(first + half, count - half);
+				startJob(joinJob);
+				return;
+			}
+			startJob(joinJob);
+		}
+		// The job pool is full. Sort on this thread
+	}
+	const auto begin = state->first + first;
+	std::sort(begin, begin + count, state->compare);
+	if (toScratch) {
+		std::move(begin, begin + count, state->scratch + first);
+	}
+}
+
+template <typename State>
+void sortRootJob(const JobParams& prm) {
+	State* const state = getCallableTuple<State>(prm.args);
+	if (! state->scratch) {
+		state->allocatedScratch.resize(state->count);
+		state->scratch = state->allocatedScratch.data();
+	}
+	sortRange(SharedStateReference<State> { state }, prm.job, 0, state->count, false);
+}
+
+template <size_t N>
+struct TileBox {
+	std::array<size_t, N> begin;
+	std::array<size_t, N> end;
+};
+
+template <size_t N, typename Body>
+struct TiledLoopState {
+	Body                  body;
+	std::array<size_t, N> tileSize;
+	TileBox<N>            box;
+	std::atomic_size_t    referenceCount = 0;
+
+	void invoke(const TileBox<N>& tileBox, size_t threadIndex) {
+		if constexpr (N == 2) {
+			if constexpr (std::is_invocable_v<Body&, size_t, size_t, size_t, size_t, size_t>) {
+				body(tileBox.begin[0], tileBox.end[0], tileBox.begin[1], tileBox.end[1], threadIndex);
+			}
+			else {
+				body(tileBox.begin[0], tileBox.end[0], tileBox.begin[1], tileBox.end[1]);
+			}
+		}
+		else {
+			if constexpr (std::is_invocable_v<Body&, size_t, size_t, size_t, size_t, size_t, size_t, size_t>) {
+				body(tileBox.begin[0], tileBox.end[0], tileBox.begin[1], tileBox.end[1], tileBox.begin[2], tileBox.end[2], threadIndex);
+			}
+			else {
+				body(tileBox.begin[0], tileBox.end[0], tileBox.begin[1], tileBox.end[1], tileBox.begin[2], tileBox.end[2]);
+			}
+		}
+	}
+};
+
+template <typename State, size_t N>
+void runTiledLoop(SharedStateReference<State> state, JobId job, TileBox<N> box, size_t threadIndex);
+
+template <typename State, size_t N>
+void tiledLoopJob(const JobParams& prm) {
+	auto [state, box] = unpackJobArgs<State*, TileBox<N>>(prm.args);
+	runTiledLoop(SharedStateReference<State>::adopt(state), prm.job, box, prm.threadIndex);
+}
+
+// Splits a box in halves along its longest axis, measured in tiles, until it fits in a tile
+template <typename State, size_t N>
+void runTiledLoop(SharedStateReference<State> state, JobId job, TileBox<N> box, size_t threadIndex) {
+	for (;;) {
+		size_t splitAxis = 0;
+		size_t maxTileCount = 0;
+		for (size_t axis = 0; axis < N; ++axis) {
+			const size_t tileCount = (box.end[axis] - box.begin[axis] + state->tileSize[axis] - 1) / state->tileSize[axis];
+			if (tileCount > maxTileCount) {
+				maxTileCount = tileCount;
+				splitAxis = axis;
+			}
+		}
+		if (maxTileCount <= 1) {
+			break;
+		}
+		// Split off the right half into a new job
+		TileBox<N> rightBox = box;
+		rightBox.begin[splitAxis] = box.begin[splitAxis] + (maxTileCount / 2) * state->tileSize[splitAxis];
+		box.end[splitAxis] = rightBox.begin[splitAxis];
+		if (JobId child = createChildJob(job, tiledLoopJob<State, N>, state.get(), rightBox); child) {
+			state.share().release(); // adopted by the job
+			startJob(child);
+		}
+		else {
+			// The job pool is full. Process the box on this thread
+			runTiledLoop(state.share(), job, rightBox, threadIndex);
+		}
+	}
+	state->invoke(box, threadIndex);
+}
+
+template <typename State, size_t N>
+void tiledLoopRootJob(const JobParams& prm) {
+	State* const state = getCallableTuple<State>(prm.args);
+	runTiledLoop<State, N>(SharedStateReference<State> { state }, prm.job, state->box, prm.threadIndex);
+}
+
+// Arguments are packed as a byte copy of a tuple of the same type, so each element is copied from its own offset in that tuple
+template <typename Tuple, size_t... Index>
+Tuple unpackJobArgsImpl(const void* args, std::index_sequence<Index...>) {
+	Tuple             tuple;
+	const char* const base = reinterpret_cast<const char*>(&tuple);
+	(std::memcpy(&std::get<Index>(tuple), static_cast<const char*>(args) + (reinterpret_cast<const char*>(&std::get<Index>(tuple)) - base),
+	             sizeof(std::tuple_element_t<Index, Tuple>)),
+	 ...);
+	return tuple;
+}
+
+} // namespace detail
+
+template <typename T, typename Reduce, typename Combine>
+JobId parallelReduce(JobId parentJobId, size_t begin, size_t end, size_t grainSize, T identity, Reduce&& reduce, Combine&& combine, T* result) {
+	using State = detail::ReduceState<T, std::decay_t<Reduce>, std::decay_t<Combine>>;
+	static_assert(std::is_convertible_v<std::invoke_result_t<std::decay_t<Reduce>&, size_t, size_t, const T&>, T>,
+	              "reduce must have signature T(size_t begin, size_t end, const T& init)");
+	static_assert(std::is_convertible_v<std::invoke_result_t<std::decay_t<Combine>&, T, T>, T>, "combine must have signature T(T, T)");
+	assert(begin <= end);
+	assert(result);
+
+	return detail::createStateJob<State>(parentJobId, detail::reduceRootJob<State>, std::forward<Reduce>(reduce), std::forward<Combine>(combine),
+	                                     std::move(identity), result, begin, end, std::max<size_t>(grainSize, 1));
+}
+
+template <typename T, typename Combine>
+JobId parallelScan(JobId parentJobId, const T* input, T* output, size_t count, size_t grainSize, Combine&& combine) {
+	using State = detail::ScanState<T, std::decay_t<Combine>>;
+	static_assert(std::is_convertible_v<std::invoke_result_t<std::decay_t<Combine>&, const T&, const T&>, T>, "combine must have signature T(T, T)");
+	assert(input || count == 0);
+	assert(output || count == 0);
+
+	return detail::createStateJob<State>(parentJobId, detail::scanRootJob<State>, std::forward<Combine>(combine), input, output, count,
+	                                     std::max<size_t>(grainSize, 1));
+}
+
+template <typename RandomIt, typename Compare>
+JobId parallelSort(JobId parentJobId, RandomIt first, RandomIt last, size_t grainSize, Compare&& compare,
+                   typename std::iterator_traits<RandomIt>::value_type* scratch) {
+	using State = detail::SortState<RandomIt, std::decay_t<Compare>>;
+	assert(first <= last);
+
+	return detail::createStateJob<State>(parentJobId, detail::sortRootJob<State>, std::forward<Compare>(compare), first, scratch,
+	                                     static_cast<size_t>(last - first), std::max<size_t>(grainSize, 1));
+}
+
+template <typename Body>
+JobId parallelFor2D(JobId parentJobId, size_t sizeX, size_t sizeY, size_t tileSizeX, size_t tileSizeY, Body&& body) {
+	using State = detail::TiledLoopState<2, std::decay_t<Body>>;
+	const std::array<size_t, 2> tileSize { std::max<size_t>(tileSizeX, 1), std::max<size_t>(tileSizeY, 1) };
+	const detail::TileBox<2>    box { { 0, 0 }, { sizeX, sizeY } };
+	return detail::createStateJob<State>(parentJobId, detail::tiledLoopRootJob<State, 2>, std::forward<Body>(body), tileSize, box);
+}
+
+template <typename Body>
+JobId parallelFor3D(JobId parentJobId, size_t sizeX, size_t sizeY, size_t sizeZ, size_t tileSizeX, size_t tileSizeY, size_t tileSizeZ, Body&& body) {
+	using State = detail::TiledLoopState<3, std::decay_t<Body>>;
+	const std::array<size_t, 3> tileSize { std::max<size_t>(tileSizeX, 1), std::max<size_t>(tileSizeY, 1), std::max<size_t>(tileSizeZ, 1) };
+	const detail::TileBox<3>    box { { 0, 0, 0 }, { sizeX, sizeY, sizeZ } };
+	return detail::createStateJob<State>(parentJobId, detail::tiledLoopRootJob<State, 3>, std::forward<Body>(body), tileSize, box);
+}
+
 template <typename ArgType>
 ArgType unpackJobArg(const void* args) {
 	static_assert((std::is_trivially_copyable_v<ArgType>));
@@ -79,9 +740,7 @@ template <typename... ArgType>
 std::tuple<ArgType...> unpackJobArgs(const void* args) {
 	static_assert((std::is_trivially_copyable_v<ArgType> && ... && true));
 
-	std::tuple<ArgType...> tuple;
-	std::memcpy(&tuple, args, sizeof tuple);
-	return tuple;
+	return detail::unpackJobArgsImpl<std::tuple<ArgType...>>(args, std::index_sequence_for<ArgType...> {});
 }
 
 } // namespace Jobs
@@ -136,5 +136,41 @@ project("Example5")
 	externalincludedirs { "./", "include", }
 	links("JobSystem")
 
+project("Example6")
+	kind "ConsoleApp"
+	files { "examples/example6.cpp", "examples/common*", }
+	externalincludedirs { "./", "include", }
+	links("JobSystem")
+
+project("Example7")
+	kind "ConsoleApp"
+	files { "examples/example7.cpp", "examples/common*", }
+	externalincludedirs { "./", "include", }
+	links("JobSystem")
+
+project("Example8")
+	kind "ConsoleApp"
+	files { "examples/example8.cpp", "examples/common*", }
+	externalincludedirs { "./", "include", }
+	links("JobSystem")
+
+project("Example9")
+	kind "ConsoleApp"
+	files { "examples/example9.cpp", "examples/common*", }
+	externalincludedirs { "./", "include", }
+	links("JobSystem")
+
+project("Example10")
+	kind "ConsoleApp"
+	files { "examples/example10.cpp", "examples/common*", }
+	externalincludedirs { "./", "include", }
+	links("JobSystem")
+
+project("Example11")
+	kind "ConsoleApp"
+	files { "examples/example11.cpp", "examples/common*", }
+	externalincludedirs { "./", "include", }
+	links("JobSystem")
+
 end
 
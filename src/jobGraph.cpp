@@ -0,0 +1,212 @@
+#include "jobGraph.h"
+#include "utils.h"
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+namespace Typhoon {
+
+namespace Jobs {
+
+namespace {
+
+constexpr JobGraph::NodeId invalidNodeId = std::numeric_limits<JobGraph::NodeId>::max();
+constexpr size_t           nodeArgAlignment = alignof(std::max_align_t);
+
+} // namespace
+
+JobGraph::NodeId JobGraph::addNodeImpl(JobFunction function, const void* data, size_t dataSize) {
+	assert(function);
+	assert(nodes.size() < invalidNodeId);
+	const size_t argOffset = detail::alignPointer(static_cast<uintptr_t>(args.size()), nodeArgAlignment);
+	assert(argOffset + dataSize <= std::numeric_limits<uint32_t>::max());
+	args.resize(argOffset + dataSize);
+	if (dataSize) {
+		std::memcpy(args.data() + argOffset, data, dataSize);
+	}
+	nodes.push_back({ function, static_cast<uint32_t>(argOffset), 0, 0, 0 });
+	compiled = false;
+	return static_cast<NodeId>(nodes.size() - 1);
+}
+
+void JobGraph::addEdge(NodeId predecessor, NodeId successor) {
+	assert(predecessor < nodes.size());
+	assert(successor < nodes.size());
+	assert(predecessor != successor);
+	edges.emplace_back(predecessor, successor);
+	compiled = false;
+}
+
+void JobGraph::compile() {
+	// Sort the edges by predecessor, so that the successors of each node are contiguous
+	for (Node& node : nodes) {
+		node.successorCount = 0;
+		node.predecessorCount = 0;
+	}
+	for (const auto& [predecessor, successor] : edges) {
+		++nodes[predecessor].successorCount;
+		++nodes[successor].predecessorCount;
+	}
+	uint32_t offset = 0;
+	for (Node& node : nodes) {
+		node.firstSuccessor = offset;
+		offset += node.successorCount;
+	}
+	successors.resize(edges.size());
+	std::vector<uint32_t> successorEnd(nodes.size());
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		successorEnd[i] = nodes[i].firstSuccessor;
+	}
+	for (const auto& [predecessor, successor] : edges) {
+		successors[successorEnd[predecessor]++] = successor;
+	}
+
+	roots.clear();
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		if (nodes[i].predecessorCount == 0) {
+			roots.push_back(static_cast<NodeId>(i));
+		}
+	}
+
+#ifdef _DEBUG
+	// Check that the graph is acyclic: all the nodes must be reachable by removing nodes with no pending predecessors
+	std::vector<uint32_t> pending(nodes.size());
+	for (size_t i = 0; i < nodes.size(); ++i) {
+		pending[i] = nodes[i].predecessorCount;
+	}
+	std::vector<NodeId> visitableNodes = roots;
+	size_t              visitedNodeCount = 0;
+	while (! visitableNodes.empty()) {
+		const Node& node = nodes[visitableNodes.back()];
+		visitableNodes.pop_back();
+		++visitedNodeCount;
+		for (uint32_t i = node.firstSuccessor; i < node.firstSuccessor + node.successorCount; ++i) {
+			if (--pending[successors[i]] == 0) {
+				visitableNodes.push_back(successors[i]);
+			}
+		}
+	}
+	assert(visitedNodeCount == nodes.size() && "The job graph has a cycle");
+#endif
+
+	pendingCounts = std::make_unique<std::atomic_uint32_t[]>(nodes.size());
+	readyNodes = std::make_unique<std::atomic<NodeId>[]>(nodes.size());
+	compiled = true;
+}
+
+// Starts runner jobs for nodes pushed to the ready queue, up to one runner per thread
+void JobGraph::startRunners(size_t pushedNodeCount) {
+	for (size_t i = 0; i < pushedNodeCount;) {
+		uint32_t count = runnerCount.load(std::memory_order_relaxed);
+		if (count >= maxRunnerCount) {
+			return;
+		}
+		if (! runnerCount.compare_exchange_weak(count, count + 1, std::memory_order_relaxed)) {
+			continue;
+		}
+		++i;
+		if (JobId job = createJob(priority, runnerJob, this); job) {
+			startJob(job);
+		}
+		else {
+			// The job pool is full. The calling runner executes the nodes
+			runnerCount.fetch_sub(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+}
+
+void JobGraph::pushReadyNode(NodeId node) {
+	const uint32_t index = readyPushIndex.fetch_add(1, std::memory_order_relaxed);
+	readyNodes[index].store(node, std::memory_order_release);
+}
+
+// Returns a node from the ready queue, or invalidNodeId if the queue is empty
+JobGraph::NodeId JobGraph::popReadyNode() {
+	uint32_t index = readyPopIndex.load(std::memory_order_relaxed);
+	do {
+		if (index == readyPushIndex.load(std::memory_order_relaxed)) {
+			return invalidNodeId;
+		}
+	} while (! readyPopIndex.compare_exchange_weak(index, index + 1, std::memory_order_relaxed));
+	// The node is stored right after its slot is reserved
+	NodeId node;
+	while ((node = readyNodes[index].load(std::memory_order_acquire)) == invalidNodeId) {
+		detail::cpuPause();
+	}
+	return node;
+}
+
+// Executes ready nodes until the ready queue is empty. The thread finishing a node continues with its first ready successor, and
+// pushes the other ones to the ready queue. The calling thread must be counted in runnerCount
+void JobGraph::runNodes(size_t threadIndex) {
+	const JobId graphJobId = graphJob;
+	for (NodeId node = popReadyNode(); node != invalidNodeId;) {
+		const Node&     n = nodes[node];
+		const JobParams prm { graphJobId, threadIndex, args.data() + n.argOffset };
+		n.function(prm);
+		NodeId nextNode = invalidNodeId;
+		size_t pushedNodeCount = 0;
+		for (uint32_t i = n.firstSuccessor; i < n.firstSuccessor + n.successorCount; ++i) {
+			const NodeId successor = successors[i];
+			// A node with a single predecessor is ready. Otherwise the decrement releases the writes of the node to the successor
+			if (nodes[successor].predecessorCount == 1 || pendingCounts[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+				if (nextNode == invalidNodeId) {
+					nextNode = successor;
+				}
+				else {
+					pushReadyNode(successor);
+					++pushedNodeCount;
+				}
+			}
+		}
+		if (pushedNodeCount) {
+			startRunners(pushedNodeCount);
+		}
+		node = nextNode != invalidNodeId ? nextNode : popReadyNode();
+	}
+	// Only runners push nodes, and a runner empties the ready queue before leaving. So when the last runner leaves, all the nodes
+	// have executed, and the graph can be launched again as soon as the graph job is released
+	if (runnerCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		detail::releaseJobImpl(graphJobId);
+	}
+}
+
+void JobGraph::graphJobFunction(const JobParams& prm) {
+	JobGraph* const graph = unpackJobArg<JobGraph*>(prm.args);
+	if (graph->nodes.empty()) {
+		return;
+	}
+	// Published to the runners when they are started
+	const size_t nodeCount = graph->nodes.size();
+	for (size_t i = 0; i < nodeCount; ++i) {
+		graph->pendingCounts[i].store(graph->nodes[i].predecessorCount, std::memory_order_relaxed);
+		graph->readyNodes[i].store(invalidNodeId, std::memory_order_relaxed);
+	}
+	graph->readyPushIndex.store(0, std::memory_order_relaxed);
+	graph->readyPopIndex.store(0, std::memory_order_relaxed);
+	graph->runnerCount.store(1, std::memory_order_relaxed); // this thread
+	graph->maxRunnerCount = static_cast<uint32_t>(getWorkerThreadCount() + 1);
+	graph->priority = detail::getJobPriorityImpl(prm.job);
+	graph->graphJob = prm.job;
+	detail::retainJobImpl(prm.job);
+	for (NodeId root : graph->roots) {
+		graph->pushReadyNode(root);
+	}
+	graph->startRunners(graph->roots.size() - 1);
+	graph->runNodes(prm.threadIndex);
+}
+
+void JobGraph::runnerJob(const JobParams& prm) {
+	JobGraph* const graph = unpackJobArg<JobGraph*>(prm.args);
+	graph->runNodes(prm.threadIndex);
+}
+
+JobId createGraphJob(JobId parentJobId, JobGraph& graph) {
+	assert(graph.isCompiled());
+	return createChildJob(parentJobId, JobGraph::graphJobFunction, &graph);
+}
+
+} // namespace Jobs
+
+} // namespace Typhoon
@@ -1,10 +1,14 @@
 #include "jobSystem.h"
+#include "topology.h"
 #include "utils.h"
+#include "virtualMemory.h"
 #include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <condition_variable>
+#include <limits>
 #include <mutex>
+#include <new>
 #include <random>
 #include <thread>
 #include <vector>
@@ -16,22 +20,43 @@ namespace Jobs {
 namespace {
 
 constexpr size_t jobAlignment = TY_JS_JOB_ALIGNMENT;
-static_assert(jobAlignment >= 128 && detail::isPowerOfTwo(jobAlignment), "Job aligment must be a power of 2");
+static_assert(jobAlignment >= 64 && detail::isPowerOfTwo(jobAlignment), "Job aligment must be a power of 2");
+
+constexpr size_t spillBlockSize = TY_JS_SPILL_BLOCK_SIZE;
+constexpr size_t spillBlockAlignment = 16;
+static_assert(spillBlockSize % spillBlockAlignment == 0, "Spill block size must be a multiple of 16");
+
+#if TY_JS_WIDE_JOB_ID
+// A job identifier stores a 32 bit generation in the upper half and the 1-based job index in the lower half
+constexpr JobId  jobIndexMask = 0xFFFFFFFF;
+constexpr int    jobGenerationShift = 32;
+constexpr size_t jobGenerationSize = sizeof(uint32_t);
+#else
+constexpr size_t jobGenerationSize = 0;
+#endif
 
 #ifdef _DEBUG
-constexpr size_t jobPadding =
-    jobAlignment - sizeof(JobFunction) - sizeof(std::atomic_int_fast32_t) - sizeof(JobId) * 3 - sizeof(bool) - sizeof(bool) * 2;
+constexpr size_t jobPadding = jobAlignment - sizeof(JobFunction) - sizeof(std::atomic_int32_t) * 2 - jobGenerationSize - sizeof(JobId) * 3
+                              - sizeof(bool) * 2 - sizeof(JobPriority) - sizeof(bool) * 2;
 #else
-constexpr size_t jobPadding = jobAlignment - sizeof(JobFunction) - sizeof(std::atomic_int_fast32_t) - sizeof(JobId) * 3 - sizeof(bool);
+constexpr size_t jobPadding = jobAlignment - sizeof(JobFunction) - sizeof(std::atomic_int32_t) * 2 - jobGenerationSize - sizeof(JobId) * 3
+                              - sizeof(bool) * 2 - sizeof(JobPriority);
 #endif
 
+// The generation follows the job identifiers, so that no padding is needed with either size of identifiers
 struct alignas(jobAlignment) Job {
-	JobFunction              func;
-	std::atomic_int_fast32_t unfinished;
-	JobId                    parent;
-	JobId                    continuation;
-	JobId                    next;
-	bool                     isLambda;
+	JobFunction         func;
+	std::atomic_int32_t unfinished;
+	std::atomic_int32_t pendingPredecessors; // predecessors added with addDependency that have not finished yet
+	JobId               parent;
+	JobId               continuation; // last continuation. Continuations form a circular list, where the last one links to the first
+	JobId               next;         // next continuation of the same job
+#if TY_JS_WIDE_JOB_ID
+	std::atomic_uint32_t generation; // incremented every time the job is recycled, by its creator only
+#endif
+	bool  isLambda;
+	bool  hasSpilledData; // data holds a pointer to a spill block
+	JobPriority priority;
 #ifdef _DEBUG
 	bool started;
 	bool isContinuation;
@@ -40,228 +65,1126 @@ struct alignas(jobAlignment) Job {
 };
 
 constexpr size_t sizeJob = sizeof(Job);
+static_assert(sizeJob == jobAlignment);
+static_assert(sizeof(Job::data) >= sizeof(void*), "No room for a pointer to a spill block");
+
+// Maximum size of the arguments of a job
+constexpr size_t maxJobDataSize = std::max(sizeof(Job::data), spillBlockSize);
+
+// Storage for a JobLambda in the job data
+constexpr size_t lambdaStorageSize = sizeof(JobLambda) + alignof(JobLambda) - 1;
+static_assert(lambdaStorageSize <= maxJobDataSize);
+static_assert(alignof(JobLambda) <= spillBlockAlignment);
+#if TY_JS_JOB_ALIGNMENT >= 256 && ! defined(TY_JS_LAMBDA_CAPTURE_SIZE)
+static_assert(lambdaStorageSize <= sizeof(Job::data), "With the default settings lambdas are stored in the job");
+#endif
 
-struct JobQueue {
-	JobId* jobIds;
-	size_t jobPoolOffset;
-	size_t jobPoolCapacity;
-	size_t jobPoolMask;
-	size_t jobIndex;
-	int    top;
-	int    bottom;
-#if TY_JS_STEALING
-	std::mutex mutex; // in case other threads steal a job from this queue
+// Returns the index of a job in the job pool
+size_t getJobIndex(JobId jobId) {
+	assert(jobId);
+#if TY_JS_WIDE_JOB_ID
+	return static_cast<size_t>(jobId & jobIndexMask) - 1;
+#else
+	return static_cast<size_t>(jobId) - 1;
+#endif
+}
+
+JobId makeJobId(size_t jobIndex, [[maybe_unused]] const Job& job) {
+#if TY_JS_WIDE_JOB_ID
+	return (static_cast<JobId>(job.generation.load(std::memory_order_relaxed)) << jobGenerationShift) | static_cast<JobId>(jobIndex + 1);
+#else
+	return static_cast<JobId>(jobIndex + 1);
+#endif
+}
+
+// Returns true if the identifier refers to the current use of the job, false if the job has been recycled since
+bool isCurrentJob([[maybe_unused]] const Job& job, [[maybe_unused]] JobId jobId) {
+#if TY_JS_WIDE_JOB_ID
+	return job.generation.load(std::memory_order_relaxed) == static_cast<uint32_t>(jobId >> jobGenerationShift);
+#else
+	return true;
+#endif
+}
+
+// Chase-Lev work-stealing deque over a ring of job identifiers
+// The owner thread pushes and pops at the bottom (LIFO), other threads steal from the top (FIFO)
+// top and bottom are free running counters, wrap-around is handled with unsigned arithmetic
+struct JobDeque {
+	std::atomic<JobId>* jobIds;
+	alignas(cacheLineSize) std::atomic_size_t top;    // written by thieves
+	alignas(cacheLineSize) std::atomic_size_t bottom; // written by the owner only
+};
+
+// Deque of the background jobs, the last one. The others hold frame jobs
+constexpr size_t backgroundLevel = static_cast<size_t>(JobPriority::background);
+constexpr size_t frameLevelCount = backgroundLevel;
+
+// Size of a memory page, the granularity at which memory is placed on NUMA nodes
+constexpr size_t pageSize = 4096;
+static_assert(jobAlignment <= pageSize);
+
+// Jobs of a thread, with one deque per priority
+// Each queue is on its own memory pages, local to its thread, so that queues never share a cache line
+struct alignas(pageSize) JobQueue {
+	JobDeque            deques[jobPriorityCount];
+	size_t              jobPoolOffset;
+	size_t              jobPoolCapacity;
+	size_t              jobPoolMask;
+	size_t              jobIndex;
+	size_t              spillPoolOffset;
+	size_t              spillBlockIndex;
+#if TY_JS_PROFILE
+	size_t createdJobCount;
+#endif
+	alignas(cacheLineSize) std::atomic_size_t givenJobCount; // jobs stolen from this queue
+#if TY_JS_PROFILE
+	// Incremented by any thread finishing a job of this thread pool, for the maxLiveJobs statistic. On its own cache line
+	alignas(cacheLineSize) std::atomic_size_t finishedJobCount;
 #endif
-	std::thread::id threadId;
+	alignas(cacheLineSize) std::thread::id threadId;
 	size_t          index;
+	bool            isBackground;                          // background worker thread
+	uint8_t         victims[maxThreads - 1];               // indices of the other queues, closest first
+	size_t          victimDistanceEnd[stealDistanceCount]; // end of the victims at each distance
+	uint32_t        randomState;                           // for choosing victims
+	unsigned        priorityTurn;                          // jobs found since lower priorities were given precedence
+	size_t          starvedLevel;                          // last priority given precedence
 	ThreadStats     stats;
+	// Parking of the worker thread
+	alignas(cacheLineSize) std::atomic_bool sleeping; // set by the owner, cleared by the thread waking it up
+	std::mutex              parkMutex;
+	std::condition_variable parkCv;
+	bool                    wakeUp; // protected by parkMutex
 #if TY_JS_PROFILE
 	std::chrono::steady_clock::time_point startTime;
 #endif
 };
 
-thread_local size_t tl_threadIndex = 0;
+// Worker threads executing the same kind of jobs
+// Pushing such a job wakes up a thread of the group
+struct WorkerGroup {
+	size_t firstThread; // index of the queue of the first thread
+	size_t threadCount;
+	alignas(cacheLineSize) std::atomic_int32_t searchingThreadCount { 0 }; // awake workers looking for jobs
+	std::atomic_int32_t                        sleepingThreadCount { 0 };
+};
+
+// Threads blocked in waitForJob, on the bucket of the job they wait for
+struct alignas(cacheLineSize) WaitBucket {
+	std::atomic_int32_t     waiterCount { 0 };
+	std::mutex              mutex;
+	std::condition_variable cv;
+};
+
+constexpr size_t waitBucketCount = 64;
+
+// Index of the threads that have no queue, as they were not created by the job system
+constexpr size_t externalThreadIndex = std::numeric_limits<size_t>::max();
+
+thread_local size_t tl_threadIndex = externalThreadIndex;
 
 } // namespace
 
 struct JobSystem {
 	JobSystemAllocator                 allocator;
 	std::vector<std::thread>           workerThreads;
-	void*                              jobPoolMemory;
 	Job*                               jobPool;
-	JobId*                             jobIdPool;
-	size_t                             threadCount; // main + worker threads
+	JobPoolMemory                      jobPoolMemory; // memory actually backing the job pool
+	std::atomic<JobId>*                jobIdPool;
+	char*                              spillPool; // arguments that do not fit in Job::data
+	std::atomic_bool*                  spillBlockInUse;
+	size_t                             spillBlocksPerThread;
+	size_t                             threadCount; // main + worker threads + background worker threads
 	size_t                             jobsPerThread;
 	size_t                             jobCapacity;
-	JobQueue                           queues[maxThreads];
-	std::mutex                         cv_m;
-	std::condition_variable            semaphore;
-	std::atomic_int32_t                activeJobCount { 0 };
-	std::mt19937                       randomEngine { std::random_device {}() };
-	std::uniform_int_distribution<int> dist;
-	bool                               isRunning;
+	JobQueue*                          queues;           // one per thread, constructed by the thread itself
+	std::atomic_size_t                 readyThreadCount; // threads that have initialized their queue
+	WorkerGroup                        frameWorkers;      // execute high, normal and low priority jobs
+	WorkerGroup                        backgroundWorkers; // execute background jobs first, then frame jobs
+	WaitBucket                         waitBuckets[waitBucketCount];
+	std::atomic_bool                   isRunning;
+	JobSystemSettings                  settings;
 };
 
 JobQueue& getQueue(JobId jobId, JobSystem& js) {
 	assert(jobId);
-	return js.queues[(jobId - 1) / js.jobsPerThread];
+	return js.queues[getJobIndex(jobId) / js.jobsPerThread];
 }
 
 namespace {
 
 Job& getJob(Job* jobPool, JobId jobId) {
-	assert(jobId);
-	return jobPool[jobId - 1];
+	Job& job = jobPool[getJobIndex(jobId)];
+	assert(isCurrentJob(job, jobId) && "Stale job identifier");
+	return job;
 }
 
 JobQueue& getThisThreadQueue(JobSystem& js) {
+	assert(tl_threadIndex != externalThreadIndex && "Only the threads of the job system can create and start jobs");
 	return js.queues[tl_threadIndex];
 }
 
-// Adds a job to the private end of the queue (LIFO)
+// Returns the arguments of a job, stored either in the job itself or in a spill block
+void* getJobData(Job& job) {
+	if (job.hasSpilledData) {
+		void* spillBlock;
+		std::memcpy(&spillBlock, job.data, sizeof spillBlock);
+		return spillBlock;
+	}
+	return job.data;
+}
+
+// Returns a spill block to the spill pool
+void releaseSpillBlock(JobSystem& js, void* spillBlock) {
+	const size_t blockIndex = (static_cast<char*>(spillBlock) - js.spillPool) / spillBlockSize;
+	js.spillBlockInUse[blockIndex].store(false, std::memory_order_release);
+}
+
+// Returns the number of jobs in a queue given its bottom and top counters
+// The result is negative when the owner has reserved the last job in popJob
+ptrdiff_t queueSize(size_t bottom, size_t top) {
+	return static_cast<ptrdiff_t>(bottom - top);
+}
+
+// Returns the number of jobs in the deques [firstLevel, endLevel) of a queue
+size_t queuedJobCount(const JobQueue& queue, size_t firstLevel, size_t endLevel, std::memory_order order) {
+	size_t count = 0;
+	for (size_t level = firstLevel; level < endLevel; ++level) {
+		const JobDeque& deque = queue.deques[level];
+		count += static_cast<size_t>(std::max<ptrdiff_t>(queueSize(deque.bottom.load(order), deque.top.load(order)), 0));
+	}
+	return count;
+}
+
+bool isBackgroundGroup(const JobSystem& js, const WorkerGroup& group) {
+	return &group == &js.backgroundWorkers;
+}
+
+// Returns true if any queue holds a job executed by a group of workers
+bool hasQueuedJobs(const JobSystem& js, const WorkerGroup& group) {
+	const size_t firstLevel = isBackgroundGroup(js, group) ? backgroundLevel : 0;
+	const size_t endLevel = isBackgroundGroup(js, group) ? jobPriorityCount : frameLevelCount;
+	for (size_t i = 0; i < js.threadCount; ++i) {
+		if (queuedJobCount(js.queues[i], firstLevel, endLevel, std::memory_order_seq_cst) > 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Returns the group of workers executing the jobs of a deque
+WorkerGroup& getWorkerGroup(JobSystem& js, size_t level) {
+	return level == backgroundLevel ? js.backgroundWorkers : js.frameWorkers;
+}
+
+// Wakes up a parked worker thread. Returns false if the worker is not sleeping or someone else woke it up already
+bool unparkWorker(JobQueue& queue) {
+	bool expected = true;
+	if (! queue.sleeping.load(std::memory_order_relaxed) || ! queue.sleeping.compare_exchange_strong(expected, false)) {
+		return false;
+	}
+	{
+		std::lock_guard lock { queue.parkMutex };
+		queue.wakeUp = true;
+	}
+	queue.parkCv.notify_one();
+	return true;
+}
+
+// Wakes up one sleeping worker thread of a group, if any. The woken thread starts searching for jobs
+void wakeWorker(JobSystem& js, WorkerGroup& group) {
+	const size_t first = tl_threadIndex; // spread wake-ups across workers
+	for (size_t i = 0; i < group.threadCount && group.sleepingThreadCount.load() > 0; ++i) {
+		JobQueue& queue = js.queues[group.firstThread + (first + i) % group.threadCount];
+		if (unparkWorker(queue)) {
+			group.searchingThreadCount.fetch_add(1);
+			group.sleepingThreadCount.fetch_sub(1);
+			return;
+		}
+	}
+}
+
+// Wakes up workers of a group, if needed, after publishing jobs of the group to a queue
+void notifyPushedJobs(JobSystem& js, WorkerGroup& group, size_t jobCount) {
+	// Order the publication before reading the thread counters. Pairs with the fence in parkWorker
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	// Searching workers will find some of the jobs. Wake up a sleeping worker for each one of the others
+	const size_t searchingCount = static_cast<size_t>(group.searchingThreadCount.load(std::memory_order_relaxed));
+	const size_t wakeUpCount = std::min(jobCount, group.threadCount);
+	for (size_t i = searchingCount; i < wakeUpCount && group.sleepingThreadCount.load(std::memory_order_relaxed) > 0; ++i) {
+		wakeWorker(js, group);
+	}
+}
+
+// Returns the deque of a queue holding a job
+size_t getQueueLevel(const JobSystem& js, JobId jobId) {
+	const size_t level = static_cast<size_t>(getJob(js.jobPool, jobId).priority);
+	if (level == backgroundLevel && (js.backgroundWorkers.threadCount == 0 || ! TY_JS_STEALING)) {
+		// Nobody would take the job from this queue
+		return static_cast<size_t>(JobPriority::low);
+	}
+	return level;
+}
+
+// Returns true if a thread executes the frame jobs of its own queue
+// Background workers leave them to frame threads, which steal them, unless there are no frame workers to do so
+bool popsOwnFrameJobs(const JobQueue& queue, const JobSystem& js) {
+	return ! queue.isBackground || js.frameWorkers.threadCount == 0 || ! TY_JS_STEALING;
+}
+
+// Returns true if a thread can execute a ready job directly, instead of pushing it
+bool canExecuteDirectly(const JobQueue& queue, const Job& job, const JobSystem& js) {
+	if (queue.isBackground) {
+		// Frame jobs, such as continuations of background jobs, are left to frame threads
+		return job.priority == JobPriority::background;
+	}
+	// Background jobs are left to background workers, if any
+	return job.priority != JobPriority::background || js.backgroundWorkers.threadCount == 0 || ! TY_JS_STEALING;
+}
+
+bool isDequeFull(const JobQueue& queue, const JobDeque& deque) {
+	return queueSize(deque.bottom.load(std::memory_order_relaxed), deque.top.load(std::memory_order_acquire))
+	       >= static_cast<ptrdiff_t>(queue.jobPoolCapacity);
+}
+
+void executeJob(JobId jobId, JobSystem& js, JobQueue& queue);
+bool handleDequeOverflow(JobQueue& queue, const JobDeque& deque, JobId jobId, JobSystem& js);
+
+// Adds a job to the private end of the queue of its priority (LIFO)
 void pushJob(JobQueue& queue, JobId jobId, JobSystem& js) {
 	assert(queue.threadId == std::this_thread::get_id());
+	const size_t level = getQueueLevel(js, jobId);
+	JobDeque&    deque = queue.deques[level];
+	if (isDequeFull(queue, deque) && handleDequeOverflow(queue, deque, jobId, js)) {
+		return;
+	}
+	const size_t b = deque.bottom.load(std::memory_order_relaxed);
 	++queue.stats.numEnqueuedJobs;
-	{
-#if TY_JS_STEALING
-		std::lock_guard lock { queue.mutex };
-#endif
-		assert(queue.top <= queue.bottom);
-		// TODO check capacity
-		queue.jobIds[queue.bottom & queue.jobPoolMask] = jobId;
-		++queue.bottom;
+	deque.jobIds[b & queue.jobPoolMask].store(jobId, std::memory_order_relaxed);
+	// Publish the job (and its data) to thieves
+	deque.bottom.store(b + 1, std::memory_order_release);
+	notifyPushedJobs(js, getWorkerGroup(js, level), 1);
+}
+
+// Adds jobs to the private ends of the queues of their priorities, as pushJob
+// Each deque is published once for all its new jobs, and workers are woken up once for all the jobs
+void pushJobs(JobQueue& queue, const JobId* jobIds, size_t count, JobSystem& js) {
+	assert(queue.threadId == std::this_thread::get_id());
+	size_t bottoms[jobPriorityCount];
+	size_t tops[jobPriorityCount];
+	size_t pushedCounts[jobPriorityCount];
+	auto   beginPush = [&queue, &bottoms, &tops, &pushedCounts] {
+		for (size_t level = 0; level < jobPriorityCount; ++level) {
+			bottoms[level] = queue.deques[level].bottom.load(std::memory_order_relaxed);
+			tops[level] = queue.deques[level].top.load(std::memory_order_acquire);
+			pushedCounts[level] = 0;
+		}
+	};
+	auto publish = [&queue, &js, &bottoms, &pushedCounts] {
+		size_t groupJobCounts[2] {}; // frame and background jobs
+		for (size_t level = 0; level < jobPriorityCount; ++level) {
+			if (pushedCounts[level]) {
+				// Publish the jobs (and their data) to thieves
+				queue.deques[level].bottom.store(bottoms[level], std::memory_order_release);
+				groupJobCounts[level == backgroundLevel] += pushedCounts[level];
+			}
+		}
+		queue.stats.numEnqueuedJobs += groupJobCounts[0] + groupJobCounts[1];
+		if (groupJobCounts[0]) {
+			notifyPushedJobs(js, js.frameWorkers, groupJobCounts[0]);
+		}
+		if (groupJobCounts[1]) {
+			notifyPushedJobs(js, js.backgroundWorkers, groupJobCounts[1]);
+		}
+	};
+
+	beginPush();
+	for (size_t i = 0; i < count; ++i) {
+		const JobId jobId = jobIds[i];
+		if (! jobId) {
+			continue; // rejected by startJobs
+		}
+		const size_t level = getQueueLevel(js, jobId);
+		JobDeque&    deque = queue.deques[level];
+		if (queueSize(bottoms[level], tops[level]) >= static_cast<ptrdiff_t>(queue.jobPoolCapacity)) {
+			tops[level] = deque.top.load(std::memory_order_acquire);
+			if (queueSize(bottoms[level], tops[level]) >= static_cast<ptrdiff_t>(queue.jobPoolCapacity)) {
+				// The queue is full of jobs from other threads. Publish the jobs pushed so far, then execute the job now or wait for room
+				publish();
+				const bool executed = handleDequeOverflow(queue, deque, jobId, js);
+				// The jobs executed meanwhile may have pushed other jobs
+				beginPush();
+				if (executed) {
+					continue;
+				}
+			}
+		}
+		deque.jobIds[bottoms[level]++ & queue.jobPoolMask].store(jobId, std::memory_order_relaxed);
+		++pushedCounts[level];
 	}
-	js.activeJobCount.fetch_add(1);
-	js.semaphore.notify_all(); // wake up working threads
+	publish();
 }
 
-// Pops a job from the private end of the queue (LIFO)
-JobId popJob(JobQueue& queue, JobSystem& js) {
+// Pops a job from the private end of the deque of a priority (LIFO)
+JobId popJob(JobQueue& queue, size_t level) {
 	assert(queue.threadId == std::this_thread::get_id());
+	JobDeque&    deque = queue.deques[level];
+	const size_t b = deque.bottom.load(std::memory_order_relaxed) - 1;
+	// Only the owner pushes jobs, so a deque seen empty stays empty
+	if (queueSize(b + 1, deque.top.load(std::memory_order_relaxed)) <= 0) {
+		return nullJobId;
+	}
 #if TY_JS_STEALING
-	std::lock_guard lock { queue.mutex };
-#endif
-	if (queue.bottom <= queue.top) {
+	// Reserve the bottom job, then check for a race with thieves
+	deque.bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	size_t t = deque.top.load(std::memory_order_relaxed);
+	if (queueSize(b, t) < 0) {
+		// Empty deque
+		deque.bottom.store(b + 1, std::memory_order_relaxed);
 		return nullJobId;
 	}
-	--queue.bottom;
-	js.activeJobCount.fetch_sub(1);
-	return queue.jobIds[queue.bottom & queue.jobPoolMask];
+	JobId job = deque.jobIds[b & queue.jobPoolMask].load(std::memory_order_relaxed);
+	if (b == t) {
+		// Last job. Compete with thieves for it
+		if (! deque.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			job = nullJobId; // a thief got it
+		}
+		deque.bottom.store(b + 1, std::memory_order_relaxed);
+	}
+#else
+	deque.bottom.store(b, std::memory_order_relaxed);
+	const JobId job = deque.jobIds[b & queue.jobPoolMask].load(std::memory_order_relaxed);
+#endif
+	return job;
+}
+
+// Returns the priority from which a thread starts looking for jobs, before going on with the following ones
+// Higher priorities come first, except every priorityStarvationLimit jobs, when each lower priority in turn is given precedence
+size_t getFirstPriorityLevel(const JobQueue& queue, const JobSystemSettings& settings) {
+	if (settings.priorityStarvationLimit == 0 || queue.priorityTurn + 1 < settings.priorityStarvationLimit) {
+		return 0;
+	}
+	return queue.starvedLevel % (frameLevelCount - 1) + 1;
+}
+
+// Counts a job found starting from a priority. Searches finding no job do not count
+void advancePriorityTurn(JobQueue& queue, size_t firstLevel) {
+	if (firstLevel == 0) {
+		++queue.priorityTurn;
+	}
+	else {
+		queue.priorityTurn = 0;
+		queue.starvedLevel = firstLevel;
+	}
 }
 
 #if TY_JS_STEALING
-JobId stealJob(JobQueue& queue) {
-	std::lock_guard lock { queue.mutex };
-	if (queue.bottom <= queue.top) {
+// Steals a job from the public end of the deque of a priority (FIFO)
+JobId stealJob(JobQueue& queue, size_t level) {
+	JobDeque& deque = queue.deques[level];
+	size_t    t = deque.top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const size_t b = deque.bottom.load(std::memory_order_acquire);
+	if (queueSize(b, t) <= 0) {
 		return nullJobId;
 	}
-	const JobId job = queue.jobIds[queue.top & queue.jobPoolMask];
-	++queue.top;
+	const JobId job = deque.jobIds[t & queue.jobPoolMask].load(std::memory_order_relaxed);
+	if (! deque.top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return nullJobId; // lost the race with the owner or another thief
+	}
+	queue.givenJobCount.fetch_add(1, std::memory_order_relaxed);
 	return job;
 }
+
+// Moves up to half of the jobs left in a deque of the victim queue to the private end of the same deque of the thief queue
+// Half of the free room in the thief deque is left for the jobs that the thief will push
+size_t stealHalf(JobQueue& victim, JobQueue& queue, size_t level, JobSystem& js) {
+	const JobDeque& victimDeque = victim.deques[level];
+	JobDeque&       deque = queue.deques[level];
+	const ptrdiff_t available = queueSize(victimDeque.bottom.load(std::memory_order_acquire), victimDeque.top.load(std::memory_order_acquire));
+	const size_t    b = deque.bottom.load(std::memory_order_relaxed);
+	const size_t    room = (queue.jobPoolCapacity - queueSize(b, deque.top.load(std::memory_order_acquire))) / 2;
+	const size_t    maxCount = std::min(static_cast<size_t>(std::max<ptrdiff_t>(available, 0)) / 2, room);
+	size_t          count = 0;
+	for (; count < maxCount; ++count) {
+		const JobId job = stealJob(victim, level);
+		if (! job) {
+			break;
+		}
+		deque.jobIds[(b + count) & queue.jobPoolMask].store(job, std::memory_order_relaxed);
+	}
+	if (count) {
+		// Publish all the stolen jobs at once
+		deque.bottom.store(b + count, std::memory_order_release);
+		notifyPushedJobs(js, getWorkerGroup(js, level), 1);
+	}
+	return count;
+}
+
+// Steals a job of a priority from another queue. Victims are visited by distance, closest first
+// Victims at the same distance are visited in random order, starting from a uniformly chosen one
+JobId stealFromOtherQueues(JobQueue& queue, size_t level, JobSystem& js) {
+	size_t begin = 0;
+	for (size_t distance = 0; distance < stealDistanceCount; ++distance) {
+		const size_t end = queue.victimDistanceEnd[distance];
+		const size_t victimCount = end - begin;
+		const size_t first = victimCount ? detail::randomRange(queue.randomState, static_cast<uint32_t>(victimCount)) : 0;
+		for (size_t i = 0; i < victimCount; ++i) {
+			JobQueue& victim = js.queues[queue.victims[begin + (first + i) % victimCount]];
+			++queue.stats.numAttemptedStealings;
+			if (const JobId job = stealJob(victim, level); job) {
+				size_t count = 1;
+				if (js.settings.stealHalf && (level == backgroundLevel || popsOwnFrameJobs(queue, js))) {
+					count += stealHalf(victim, queue, level, js);
+				}
+				queue.stats.numStolenJobs += count;
+				queue.stats.numStolenJobsByPriority[level] += count;
+				queue.stats.numStolenJobsByDistance[distance] += count;
+				return job;
+			}
+		}
+		begin = end;
+	}
+	return nullJobId;
+}
 #endif
 
-void finishJob(JobSystem& js, JobId jobId, JobQueue& queue) {
-	Job&          job = getJob(js.jobPool, jobId);
+bool isJobFinished(JobSystem& js, JobId jobId) {
+	const Job& job = js.jobPool[getJobIndex(jobId)];
+	// A recycled job has finished
+	return ! isCurrentJob(job, jobId) || job.unfinished == 0;
+}
+
+WaitBucket& getWaitBucket(JobSystem& js, JobId jobId) {
+	return js.waitBuckets[getJobIndex(jobId) % waitBucketCount];
+}
+
+// Blocks the calling thread until a job has finished, without polling
+void blockUntilFinished(JobSystem& js, JobId jobId) {
+	WaitBucket&      bucket = getWaitBucket(js, jobId);
+	std::unique_lock lock { bucket.mutex };
+	// Either finishJob sees this thread registered, or this thread sees the job finished
+	bucket.waiterCount.fetch_add(1);
+	while (! isJobFinished(js, jobId)) {
+		bucket.cv.wait(lock);
+	}
+	bucket.waiterCount.fetch_sub(1);
+}
+
+// Wakes up the threads blocked on the bucket of a finished job. Threads waiting for other jobs of the bucket wait again
+void wakeWaiters(JobSystem& js, JobId jobId) {
+	WaitBucket& bucket = getWaitBucket(js, jobId);
+	{
+		// A waiter holds the mutex from its check of the job to its wait
+		std::lock_guard lock { bucket.mutex };
+	}
+	bucket.cv.notify_all();
+}
+
+// Function of the links added to the continuations of a predecessor by addDependency. Links are never executed
+void dependencyLinkFunction(const JobParams& /*prm*/) {
+	assert(false);
+}
+
+JobId finishJob(JobSystem& js, JobId jobId, JobQueue& queue);
+
+// Releases a dependency link of a finished predecessor
+// Returns the dependent job if all its predecessors have finished, nullJobId otherwise
+JobId releaseDependency(JobSystem& js, JobId linkId, JobQueue& queue) {
+	Job&  link = getJob(js.jobPool, linkId);
+	JobId jobId;
+	std::memcpy(&jobId, link.data, sizeof jobId);
+	finishJob(js, linkId, queue); // recycle the link
+	// Release the writes of the predecessors to the thread executing the job
+	return getJob(js.jobPool, jobId).pendingPredecessors.fetch_sub(1, std::memory_order_acq_rel) == 1 ? jobId : nullJobId;
+}
+
+// Hands a ready job over to the calling thread if it has none yet, otherwise pushes it
+void handOverOrPushJob(JobSystem& js, JobId jobId, JobQueue& queue, JobId& readyJob) {
+	if (! readyJob && canExecuteDirectly(queue, getJob(js.jobPool, jobId), js)) {
+		readyJob = jobId;
+	}
+	else {
+		pushJob(queue, jobId, js);
+	}
+}
+
+// Returns the first ready continuation, which the calling thread executes directly without going through a queue
+// The other continuations are pushed. Returns nullJobId if the job has not finished or if it has no continuations
+JobId finishJob(JobSystem& js, JobId jobId, JobQueue& queue) {
+	Job& job = getJob(js.jobPool, jobId);
+	// Read the links before finishing, as the job can be recycled right after
+	const JobId   lastContinuation = job.continuation;
+	const JobId   parent = job.parent;
+	void* const   spillBlock = job.hasSpilledData ? getJobData(job) : nullptr;
 	const int32_t unfinishedJobCount = --(job.unfinished);
 	assert(unfinishedJobCount >= 0);
+	JobId readyJob = nullJobId;
 	if (unfinishedJobCount == 0) {
-		// Push continuations
-		for (JobId c = job.continuation; c; c = getJob(js.jobPool, c).next) {
-			pushJob(queue, c, js);
+		// The arguments stay valid until the job and its children have finished
+		if (spillBlock) {
+			releaseSpillBlock(js, spillBlock);
+		}
+#if TY_JS_PROFILE
+		getQueue(jobId, js).finishedJobCount.fetch_add(1, std::memory_order_relaxed);
+#endif
+		// The waiters are counted after decrementing unfinished. Pairs with blockUntilFinished
+		if (getWaitBucket(js, jobId).waiterCount.load() > 0) {
+			wakeWaiters(js, jobId);
+		}
+		// Start continuations, from the first one
+		JobId c = lastContinuation ? getJob(js.jobPool, lastContinuation).next : nullJobId;
+		while (c) {
+			Job&        continuationJob = getJob(js.jobPool, c);
+			const JobId next = c == lastContinuation ? nullJobId : continuationJob.next;
+			const JobId startedJob = continuationJob.func == dependencyLinkFunction ? releaseDependency(js, c, queue) : c;
+			if (startedJob) {
+				handOverOrPushJob(js, startedJob, queue, readyJob);
+			}
+			c = next;
 		}
 		// Notify parent
-		if (job.parent) {
-			finishJob(js, job.parent, queue);
+		if (parent) {
+			if (const JobId parentReadyJob = finishJob(js, parent, queue); parentReadyJob) {
+				handOverOrPushJob(js, parentReadyJob, queue, readyJob);
+			}
 		}
 	}
+	return readyJob;
 }
 
+// Executes a job, then the continuations handed over by finishJob
 void executeJob(JobId jobId, JobSystem& js, JobQueue& queue) {
 #if TY_JS_PROFILE
 	const auto startTime = std::chrono::steady_clock::now();
 #endif
-	Job& job = getJob(js.jobPool, jobId);
-	assert(job.unfinished > 0);
-	const JobParams prm { jobId, queue.index, job.data };
-	if (job.isLambda) {
-		void*      ptr = detail::alignPointer(job.data, alignof(JobLambda));
-		JobLambda* lambda = static_cast<JobLambda*>(ptr);
-		(*lambda)(queue.index); // call
-		lambda->~JobLambda();   // destruct
-		job.isLambda = false;
-	}
-	else {
-		job.func(prm);
-	}
-	finishJob(js, jobId, queue);
+	do {
+		Job& job = getJob(js.jobPool, jobId);
+		assert(job.unfinished > 0);
+		++queue.stats.numExecutedJobs;
+		++queue.stats.numExecutedJobsByPriority[static_cast<size_t>(job.priority)];
+		const JobParams prm { jobId, queue.index, getJobData(job) };
+		if (job.isLambda) {
+			void*      ptr = detail::alignPointer(getJobData(job), alignof(JobLambda));
+			JobLambda* lambda = static_cast<JobLambda*>(ptr);
+			(*lambda)(queue.index); // call
+			lambda->~JobLambda();   // destruct
+			job.isLambda = false;
+		}
+		else {
+			job.func(prm);
+		}
+		jobId = finishJob(js, jobId, queue);
+	} while (jobId);
 #if TY_JS_PROFILE
 	queue.stats.runningTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime);
 #endif
 }
 
 JobId getNextJob(JobQueue& queue, JobSystem& js) {
-	JobId job = popJob(queue, js);
-	if (! job) {
+	if (queue.isBackground) {
+		// Background jobs first. Frame jobs are executed only if there are none
+		if (const JobId job = popJob(queue, backgroundLevel); job) {
+			return job;
+		}
 #if TY_JS_STEALING
-		// This worker's queue is empty. Steal from other queues
-		// TODO How to steal from the queue with most jobs (usually the main one)
-		const size_t offset = js.dist(js.randomEngine);
-		const size_t otherQueueIndex = queue.index == 0 ? (queue.index + offset) % js.threadCount : 0;
-		assert(otherQueueIndex != queue.index);
-		++queue.stats.numAttemptedStealings;
-		job = stealJob(js.queues[otherQueueIndex]);
-		if (job) {
-			++queue.stats.numStolenJobs;
-			++js.queues[otherQueueIndex].stats.numGivenJobs;
+		if (const JobId job = stealFromOtherQueues(queue, backgroundLevel, js); job) {
 			return job;
 		}
-#endif // TY_JS_STEALING
+#endif
+	}
+	// Background jobs pushed by this thread are left to background workers
+	const size_t firstLevel = getFirstPriorityLevel(queue, js.settings);
+	JobId        job = nullJobId;
+	for (size_t l = 0; l < frameLevelCount && ! job && popsOwnFrameJobs(queue, js); ++l) {
+		job = popJob(queue, (firstLevel + l) % frameLevelCount);
+	}
+#if TY_JS_STEALING
+	if (! job && js.threadCount > 1) {
+		// This thread's queue is empty. Steal from other queues
+		for (size_t l = 0; l < frameLevelCount && ! job; ++l) {
+			job = stealFromOtherQueues(queue, (firstLevel + l) % frameLevelCount, js);
+		}
+	}
+#endif
+	if (job) {
+		advancePriorityTurn(queue, firstLevel);
 	}
 	return job;
 }
 
-// Function run by a worker thread
-void worker(JobQueue& queue, size_t threadIndex, JobSystem& js) {
-	tl_threadIndex = threadIndex;
-	queue.threadId = std::this_thread::get_id();
-	while (true) {
-		std::unique_lock lk { js.cv_m };
-		js.semaphore.wait(lk, [&js] { return ! js.isRunning || js.activeJobCount.load() > 0; });
-		if (! js.isRunning) {
-			break;
+enum class IdlePhase {
+	none,
+	spinning,
+	yielding,
+	sleeping,
+};
+
+// Idle state of a thread that cannot find jobs
+struct IdleState {
+	unsigned  iteration = 0;
+	IdlePhase phase = IdlePhase::none;
+#if TY_JS_PROFILE
+	std::chrono::steady_clock::time_point phaseStartTime;
+#endif
+};
+
+IdlePhase nextIdlePhase(IdleState& idle, const JobSystemSettings& settings) {
+	const unsigned iteration = idle.iteration++;
+	if (iteration < settings.idleSpinCount) {
+		return IdlePhase::spinning;
+	}
+	if (iteration - settings.idleSpinCount < settings.idleYieldCount) {
+		return IdlePhase::yielding;
+	}
+	return IdlePhase::sleeping;
+}
+
+void enterIdlePhase(IdleState& idle, IdlePhase phase, [[maybe_unused]] ThreadStats& stats) {
+	if (phase == idle.phase) {
+		return;
+	}
+#if TY_JS_PROFILE
+	const auto now = std::chrono::steady_clock::now();
+	const auto phaseTime = std::chrono::duration_cast<std::chrono::microseconds>(now - idle.phaseStartTime);
+	if (idle.phase == IdlePhase::spinning) {
+		stats.spinningTime += phaseTime;
+	}
+	else if (idle.phase == IdlePhase::yielding) {
+		stats.yieldingTime += phaseTime;
+	}
+	else if (idle.phase == IdlePhase::sleeping) {
+		stats.sleepingTime += phaseTime;
+	}
+	idle.phaseStartTime = now;
+#endif
+	idle.phase = phase;
+}
+
+void resetIdleState(IdleState& idle, ThreadStats& stats) {
+	enterIdlePhase(idle, IdlePhase::none, stats);
+	idle.iteration = 0;
+}
+
+// Executes a pending job, if any, while waiting for an event (e.g. the completion of a job)
+// Once idle, the thread polls for the event, or blocks until a job finishes if waitedJobId is not null
+// Returns the idle phase of the thread, IdlePhase::none if it executed a job
+IdlePhase executeNextJob(JobQueue& queue, JobSystem& js, IdleState& idle, JobId waitedJobId = nullJobId) {
+	if (JobId nextJob = getNextJob(queue, js); nextJob) {
+		resetIdleState(idle, queue.stats);
+		executeJob(nextJob, js, queue);
+		return IdlePhase::none;
+	}
+	const IdlePhase phase = nextIdlePhase(idle, js.settings);
+	enterIdlePhase(idle, phase, queue.stats);
+	if (phase == IdlePhase::spinning) {
+		detail::cpuPause();
+	}
+	else if (phase == IdlePhase::yielding) {
+		std::this_thread::yield();
+	}
+	else if (waitedJobId) {
+		// No job to help with. Jobs pushed from now on are executed by the other threads
+		blockUntilFinished(js, waitedJobId);
+	}
+	else {
+		// Poll
+		std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
+	}
+	return phase;
+}
+
+// Finds a free job in the pool of a thread, starting from the one following the last allocated job
+// Jobs still in use are skipped
+bool allocateJob(JobQueue& queue, const JobSystem& js, size_t& jobIndex) {
+	for (size_t i = 0; i < queue.jobPoolCapacity; ++i) {
+		const size_t poolIndex = (queue.jobIndex + i) & queue.jobPoolMask;
+		if (js.jobPool[queue.jobPoolOffset + poolIndex].unfinished.load(std::memory_order_acquire) == 0) {
+			queue.jobIndex = (poolIndex + 1) & queue.jobPoolMask;
+			jobIndex = queue.jobPoolOffset + poolIndex;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Finds a free spill block in the pool of a thread, starting from the one following the last allocated block
+bool allocateSpillBlock(JobQueue& queue, const JobSystem& js, size_t& blockIndex) {
+	for (size_t i = 0; i < js.spillBlocksPerThread; ++i) {
+		const size_t poolIndex = (queue.spillBlockIndex + i) % js.spillBlocksPerThread;
+		std::atomic_bool& inUse = js.spillBlockInUse[queue.spillPoolOffset + poolIndex];
+		if (! inUse.load(std::memory_order_acquire)) {
+			inUse.store(true, std::memory_order_relaxed); // only the owner thread sets the flag
+			queue.spillBlockIndex = poolIndex + 1;
+			blockIndex = queue.spillPoolOffset + poolIndex;
+			return true;
 		}
+	}
+	return false;
+}
+
+// Called when the deque of a job is full of jobs from other threads (stolen jobs or continuations)
+// Executes the job now, unless it is left to another kind of thread. Then helps with pending jobs until the threads taking jobs
+// from the deque make room for it. Returns true if the job was executed
+bool handleDequeOverflow(JobQueue& queue, const JobDeque& deque, JobId jobId, JobSystem& js) {
+	++queue.stats.numQueueOverflows;
+	if (canExecuteDirectly(queue, getJob(js.jobPool, jobId), js)) {
+		executeJob(jobId, js, queue);
+		return true;
+	}
+	IdleState idle;
+	do {
+		executeNextJob(queue, js, idle);
+	} while (isDequeFull(queue, deque));
+	resetIdleState(idle, queue.stats);
+	return false;
+}
+
+// Calls allocate until it succeeds. If it fails, applies the overflow policy
+// Returns false if the allocation failed
+template <typename AllocFunc>
+bool allocateWithOverflowPolicy(JobQueue& queue, JobSystem& js, size_t& overflowCounter, AllocFunc&& allocate) {
+	if (allocate()) {
+		return true;
+	}
+	++overflowCounter;
+	if (js.settings.jobPoolOverflowPolicy == JobPoolOverflowPolicy::fail) {
+		return false;
+	}
+	// Help executing pending jobs until one of the jobs of this thread finishes
+	IdleState idle;
+	do {
+		if (executeNextJob(queue, js, idle) == IdlePhase::sleeping) {
+			// No pending job: the jobs in use are likely waiting for this thread
+			resetIdleState(idle, queue.stats);
+			return false;
+		}
+	} while (! allocate());
+	resetIdleState(idle, queue.stats);
+	return true;
+}
+
+// Puts an idle worker thread to sleep until wakeWorker or stopThreads is called
+// The caller must not be counted as a searching thread of its group. On return it is counted as searching
+void parkWorker(JobQueue& queue, WorkerGroup& group, JobSystem& js) {
+	queue.sleeping.store(true);
+	group.sleepingThreadCount.fetch_add(1);
+	// Order the registration before checking the queues. Pairs with the fence in notifyPushedJobs
+	// Either this thread sees the new job or the producer sees this thread sleeping
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (! js.isRunning || hasQueuedJobs(js, group)) {
+		bool expected = true;
+		if (queue.sleeping.compare_exchange_strong(expected, false)) {
+			group.searchingThreadCount.fetch_add(1);
+			group.sleepingThreadCount.fetch_sub(1);
+			return;
+		}
+		// Another thread is waking up this one. Consume its notification
+	}
+	std::unique_lock lock { queue.parkMutex };
+	queue.parkCv.wait(lock, [&queue] { return queue.wakeUp; });
+	queue.wakeUp = false;
+}
+
+// Function run by a worker thread
+void worker(JobQueue& queue, JobSystem& js) {
+	WorkerGroup& group = queue.isBackground ? js.backgroundWorkers : js.frameWorkers;
+	bool         searching = true; // counted in group.searchingThreadCount by initJobSystem
+	IdleState    idle;
+	while (js.isRunning) {
 		if (JobId job = getNextJob(queue, js); job) {
-			// Release lock
-			lk.unlock();
+			resetIdleState(idle, queue.stats);
+			if (searching) {
+				searching = false;
+				// If this was the last searching thread, jobs pushed meanwhile did not wake up anybody
+				if (group.searchingThreadCount.fetch_sub(1) == 1 && hasQueuedJobs(js, group)) {
+					wakeWorker(js, group);
+				}
+			}
 			executeJob(job, js, queue);
-			++queue.stats.numExecutedJobs;
+			continue;
+		}
+		if (! searching) {
+			searching = true;
+			group.searchingThreadCount.fetch_add(1);
+		}
+		const IdlePhase phase = nextIdlePhase(idle, js.settings);
+		enterIdlePhase(idle, phase, queue.stats);
+		if (phase == IdlePhase::spinning) {
+			detail::cpuPause();
+		}
+		else if (phase == IdlePhase::yielding) {
+			std::this_thread::yield();
 		}
 		else {
-			lk.unlock();
-			std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
+			group.searchingThreadCount.fetch_sub(1);
+			parkWorker(queue, group, js);
+			// Start spinning again
+			resetIdleState(idle, queue.stats);
 		}
 	}
+	resetIdleState(idle, queue.stats);
 }
 
 void stopThreads(JobSystem& js) {
-	{
-		std::unique_lock lock { js.cv_m };
-		js.isRunning = false;
+	js.isRunning = false;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	for (size_t i = 1; i < js.threadCount; ++i) {
+		unparkWorker(js.queues[i]);
 	}
-	js.semaphore.notify_all(); // notify working threads
 
 	for (auto& thread : js.workerThreads) {
 		thread.join();
 	}
 }
 
-bool isJobFinished(JobSystem& js, JobId jobId) {
-	const Job& job = getJob(js.jobPool, jobId);
-	return (job.unfinished == 0);
+void nullFunction(const JobParams& /*prm*/) {
 }
 
-void nullFunction(const JobParams& /*prm*/) {
+void* defaultAlloc(size_t size, size_t alignment, void* /*context*/) {
+	return ::operator new(size, std::align_val_t { alignment }, std::nothrow);
 }
 
-void* mallocWrap(size_t size) {
-	return malloc(size);
+void defaultFree(void* ptr, size_t /*size*/, size_t alignment, void* /*context*/) {
+	::operator delete(ptr, std::align_val_t { alignment });
+}
+
+// Allocates the job pool, falling back from huge TLB pages to transparent huge pages, then to the allocator
+// memory is set to the memory actually backing the pool
+Job* allocJobPool(size_t size, JobPoolMemory& memory, const JobSystemAllocator& allocator) {
+	if (memory == JobPoolMemory::hugeTlbPages) {
+		if (void* const ptr = detail::mapHugePages(size, true)) {
+			return static_cast<Job*>(ptr);
+		}
+		memory = JobPoolMemory::hugePages;
+	}
+	if (memory == JobPoolMemory::hugePages) {
+		if (void* const ptr = detail::mapHugePages(size, false)) {
+			return static_cast<Job*>(ptr);
+		}
+		memory = JobPoolMemory::allocator;
+	}
+	return static_cast<Job*>(allocator.alloc(size, pageSize, allocator.context));
 }
 
-void freeWrap(void* ptr) {
-	free(ptr);
+void freeJobPool(Job* jobPool, size_t size, JobPoolMemory memory, const JobSystemAllocator& allocator) {
+	if (memory == JobPoolMemory::allocator) {
+		allocator.free(jobPool, size, pageSize, allocator.context);
+	}
+	else {
+		detail::unmapHugePages(jobPool, size);
+	}
 }
 
 JobSystem* jobSystem = nullptr;
 
+// Adds a job to the linked list of the continuations of a job
+// The job links to its last continuation, which links to the first one, so that appending is O(1)
+void appendContinuation(JobSystem& js, Job& previousJob, JobId continuationId) {
+	Job& continuation = getJob(js.jobPool, continuationId);
+	if (previousJob.continuation) {
+		Job& lastContinuation = getJob(js.jobPool, previousJob.continuation);
+		continuation.next = lastContinuation.next;
+		lastContinuation.next = continuationId;
+	}
+	else {
+		continuation.next = continuationId;
+	}
+	previousJob.continuation = continuationId;
+}
+
+// Returns the location of each thread. With settings.pinThreads, worker threads are assigned a CPU
+// Locations are unknown if the threads are not pinned. If the topology is not available, only the requested CPUs are known
+std::vector<detail::CpuLocation> getThreadLocations(const JobSystemSettings& settings, size_t threadCount) {
+	std::vector<detail::CpuLocation> locations(threadCount);
+	std::vector<detail::CpuLocation> cpus;
+	if (! settings.pinThreads) {
+		return locations;
+	}
+	if (! detail::readCpuTopology(cpus)) {
+		// Pin the worker threads to the requested CPUs anyway, without cache or node information
+		for (size_t i = 1; i < threadCount && i - 1 < settings.workerCpus.size(); ++i) {
+			locations[i].cpu = settings.workerCpus[i - 1];
+		}
+		return locations;
+	}
+	// The main thread is not pinned. Place worker threads on the CPUs following the one it is running on
+	const int  mainCpu = detail::getCurrentCpu();
+	const auto mainLocation = std::find_if(cpus.begin(), cpus.end(), [mainCpu](const detail::CpuLocation& location) { return location.cpu == mainCpu; });
+	const size_t mainPosition = mainLocation != cpus.end() ? static_cast<size_t>(mainLocation - cpus.begin()) : 0;
+	locations[0] = cpus[mainPosition];
+	for (size_t i = 1; i < threadCount; ++i) {
+		const size_t worker = i - 1;
+		if (worker < settings.workerCpus.size()) {
+			const int  cpu = settings.workerCpus[worker];
+			const auto location = std::find_if(cpus.begin(), cpus.end(), [cpu](const detail::CpuLocation& location) { return location.cpu == cpu; });
+			locations[i] = location != cpus.end() ? *location : detail::CpuLocation { cpu };
+		}
+		else {
+			locations[i] = cpus[(mainPosition + i) % cpus.size()];
+		}
+	}
+	return locations;
+}
+
+StealDistance getStealDistance(const detail::CpuLocation& thief, const detail::CpuLocation& victim) {
+	if (thief.cacheId >= 0 && thief.cacheId == victim.cacheId) {
+		return StealDistance::sharedCache;
+	}
+	return thief.numaNode == victim.numaNode ? StealDistance::sameNode : StealDistance::remote;
+}
+
+// Sorts the other queues by distance from a queue
+void initVictims(JobQueue& queue, const std::vector<detail::CpuLocation>& threadLocations) {
+	size_t victimCount = 0;
+	for (size_t distance = 0; distance < stealDistanceCount; ++distance) {
+		for (size_t i = 0; i < threadLocations.size(); ++i) {
+			if (i != queue.index && getStealDistance(threadLocations[queue.index], threadLocations[i]) == static_cast<StealDistance>(distance)) {
+				queue.victims[victimCount++] = static_cast<uint8_t>(i);
+			}
+		}
+		queue.victimDistanceEnd[distance] = victimCount;
+	}
+}
+
+// Constructs the queue of a thread and initializes its slice of the job pools
+// This is done by the thread itself, so that the memory pages are allocated on its NUMA node (first-touch policy)
+void initThread(JobSystem& js, size_t threadIndex, uint32_t randomSeed, const std::vector<detail::CpuLocation>& threadLocations) {
+	tl_threadIndex = threadIndex;
+	const size_t jobsPerThread = js.jobsPerThread;
+	JobQueue&    q = *new (&js.queues[threadIndex]) JobQueue;
+	for (size_t l = 0; l < jobPriorityCount; ++l) {
+		JobDeque& deque = q.deques[l];
+		deque.jobIds = js.jobIdPool + (threadIndex * jobPriorityCount + l) * jobsPerThread;
+		for (size_t i = 0; i < jobsPerThread; ++i) {
+			new (deque.jobIds + i) std::atomic<JobId> { nullJobId };
+		}
+		deque.top = 0;
+		deque.bottom = 0;
+	}
+	q.jobPoolOffset = threadIndex * jobsPerThread;
+	q.jobPoolCapacity = jobsPerThread;
+	q.jobPoolMask = jobsPerThread - 1;
+	for (size_t i = 0; i < jobsPerThread; ++i) {
+		Job& job = js.jobPool[q.jobPoolOffset + i];
+		job.unfinished = 0;
+		job.hasSpilledData = false;
+#if TY_JS_WIDE_JOB_ID
+		job.generation = 0;
+#endif
+	}
+	q.givenJobCount = 0;
+	q.randomState = detail::hashSeed(randomSeed + static_cast<uint32_t>(threadIndex));
+	q.priorityTurn = 0;
+	q.starvedLevel = 0;
+	q.jobIndex = 0;
+#if TY_JS_PROFILE
+	q.createdJobCount = 0;
+	q.finishedJobCount = 0;
+#endif
+	q.spillPoolOffset = threadIndex * js.spillBlocksPerThread;
+	q.spillBlockIndex = 0;
+	for (size_t i = 0; i < js.spillBlocksPerThread; ++i) {
+		new (js.spillBlockInUse + q.spillPoolOffset + i) std::atomic_bool { false };
+	}
+	q.index = threadIndex;
+	q.isBackground = threadIndex > js.frameWorkers.threadCount;
+	initVictims(q, threadLocations);
+	q.stats = {};
+	q.sleeping = false;
+	q.wakeUp = false;
+	q.threadId = std::this_thread::get_id();
+#if TY_JS_PROFILE
+	q.startTime = std::chrono::steady_clock::now();
+#endif
+	js.readyThreadCount.fetch_add(1);
+}
+
+// Waits until all the threads have initialized their queue
+void waitForReadyThreads(const JobSystem& js) {
+	while (js.readyThreadCount.load() < js.threadCount) {
+		std::this_thread::yield();
+	}
+}
+
+// Entry point of a worker thread
+void workerMain(JobSystem& js, size_t threadIndex, uint32_t randomSeed, const std::vector<detail::CpuLocation>& threadLocations) {
+	// Pin the thread first, so that its memory is allocated on the node of its CPU
+	if (js.settings.pinThreads) {
+		detail::pinThisThread(threadLocations[threadIndex].cpu);
+	}
+	initThread(js, threadIndex, randomSeed, threadLocations);
+	// Workers steal from any queue
+	waitForReadyThreads(js);
+	worker(js.queues[threadIndex], js);
+}
+
+size_t alignDown(size_t value, size_t alignment) {
+	return value - value % alignment;
+}
+
+// Runs a loop over [begin, end), splitting it according to the parallelFor split mode
+// spawn(begin, end) hands a subrange over to a new job, process(begin, end) executes a subrange on this thread
+// Split points and chunk boundaries are multiples of chunkAlignment
+template <typename SpawnFunction, typename ProcessFunction>
+void splitRange(size_t begin, size_t end, size_t grainSize, size_t chunkAlignment, SpawnFunction&& spawn, ProcessFunction&& process) {
+	assert(chunkAlignment > 0);
+	grainSize = std::max(alignDown(grainSize + chunkAlignment - 1, chunkAlignment), chunkAlignment);
+	// Splits off the right half of the range
+	auto splitRight = [&begin, &end, chunkAlignment, &spawn]() {
+		size_t middle = alignDown(begin + (end - begin) / 2, chunkAlignment);
+		if (middle <= begin) {
+			middle = alignDown(begin, chunkAlignment) + chunkAlignment;
+		}
+		spawn(middle, end);
+		end = middle;
+	};
+
+	if (jobSystem->settings.parallelForSplitMode == ParallelForSplitMode::lazy) {
+		const JobQueue& queue = getThisThreadQueue(*jobSystem);
+		while (end - begin > grainSize) {
+			if (queuedJobCount(queue, 0, jobPriorityCount, std::memory_order_relaxed) == 0) {
+				// Nothing left for thieves: expose half of the remaining range
+				splitRight();
+			}
+			else {
+				const size_t chunkEnd = alignDown(begin + grainSize, chunkAlignment);
+				process(begin, chunkEnd);
+				begin = chunkEnd;
+			}
+		}
+	}
+	else {
+		while (end - begin > grainSize) {
+			splitRight();
+		}
+	}
+	process(begin, end);
+}
+
 } // namespace
 
 void initJobSystem(size_t numJobsPerThread, size_t numWorkerThreads) {
-	const JobSystemAllocator allocator { mallocWrap, freeWrap }; // default allocator
+	const JobSystemAllocator allocator { defaultAlloc, defaultFree, nullptr }; // default allocator
 	initJobSystem(numJobsPerThread, numWorkerThreads, allocator);
 }
 
 void initJobSystem(size_t numJobsPerThread, size_t numWorkerThreads, const JobSystemAllocator& allocator) {
+	JobSystemSettings settings;
+	settings.numJobsPerThread = numJobsPerThread;
+	settings.numWorkerThreads = numWorkerThreads;
+	initJobSystem(settings, allocator);
+}
+
+void initJobSystem(const JobSystemSettings& settings) {
+	const JobSystemAllocator allocator { defaultAlloc, defaultFree, nullptr }; // default allocator
+	initJobSystem(settings, allocator);
+}
+
+void initJobSystem(const JobSystemSettings& settings, const JobSystemAllocator& allocator) {
+	size_t numJobsPerThread = settings.numJobsPerThread;
+	size_t numWorkerThreads = settings.numWorkerThreads;
 	assert(numJobsPerThread > 0);
 	assert(allocator.alloc);
 	assert(allocator.free);
@@ -270,89 +1193,122 @@ void initJobSystem(size_t numJobsPerThread, size_t numWorkerThreads, const JobSy
 		numWorkerThreads = std::thread::hardware_concurrency() - 1; // main thread excluded
 	}
 
+#if TY_JS_WIDE_JOB_ID
+	constexpr size_t maxJobs = static_cast<size_t>(std::numeric_limits<uint32_t>::max()) - 1; // jobId 0 is reserved
+#else
 	constexpr size_t maxJobs = std::numeric_limits<JobId>::max() - 1; // jobId 0 is reserved
+#endif
 
 	numJobsPerThread = detail::nextPowerOfTwo(static_cast<uint32_t>(numJobsPerThread));
 	while (numJobsPerThread > maxJobs) {
 		numJobsPerThread /= 2; // keep pow of 2
 	}
 
-	size_t threadCount = numWorkerThreads + 1; // + 1 for main thread
+	size_t threadCount = numWorkerThreads + settings.numBackgroundThreads + 1; // + 1 for main thread
 	threadCount = std::min(threadCount, maxThreads);
 	threadCount = std::min(threadCount, maxJobs / numJobsPerThread);
-
-	const size_t jobCapacity = threadCount * numJobsPerThread;
-	const size_t jobPoolMemorySize = sizeof(Job) * jobCapacity + (jobAlignment - 1);
-	void* const  jobPoolMemory = allocator.alloc(jobPoolMemorySize);
-
-	Job* const jobPool = static_cast<Job*>(detail::alignPointer(jobPoolMemory, alignof(Job)));
-	for (size_t i = 0; i < jobCapacity; ++i) {
-		jobPool[i].unfinished = 0;
-	}
-
-	JobId* const jobIdPool = static_cast<JobId*>(allocator.alloc(jobCapacity * sizeof(JobId)));
-
-	auto js = new (allocator.alloc(sizeof(JobSystem))) JobSystem;
-	js->jobPoolMemory = jobPoolMemory;
+	// If there are too many threads, background worker threads are dropped first
+	numWorkerThreads = std::min(numWorkerThreads, threadCount - 1);
+	const size_t numBackgroundThreads = threadCount - 1 - numWorkerThreads;
+
+	// Each thread initializes its slice of the pools and its queue. Slices start on page boundaries when they are large enough
+	// Initializing the job pool slices also pre-faults the job pool, so that no page fault happens while jobs are created
+	const size_t  jobCapacity = threadCount * numJobsPerThread;
+	JobPoolMemory jobPoolMemory = settings.jobPoolMemory;
+	Job* const    jobPool = allocJobPool(jobCapacity * sizeof(Job), jobPoolMemory, allocator);
+
+	// One deque per priority in each queue
+	const size_t jobIdCount = jobCapacity * jobPriorityCount;
+	auto* const  jobIdPool = static_cast<std::atomic<JobId>*>(allocator.alloc(jobIdCount * sizeof(std::atomic<JobId>), pageSize, allocator.context));
+
+	// No arguments spill if a spill block is not larger than Job::data
+	const size_t spillBlocksPerThread = sizeof(Job::data) < maxJobDataSize ? settings.spillBlocksPerThread : 0;
+	const size_t spillBlockCount = threadCount * spillBlocksPerThread;
+	char* const  spillPool = spillBlockCount ? static_cast<char*>(allocator.alloc(spillBlockCount * spillBlockSize, pageSize, allocator.context)) : nullptr;
+	auto* const  spillBlockInUse =
+	    spillBlockCount ? static_cast<std::atomic_bool*>(allocator.alloc(spillBlockCount * sizeof(std::atomic_bool), alignof(std::atomic_bool), allocator.context))
+	                    : nullptr;
+
+	auto* const queues = static_cast<JobQueue*>(allocator.alloc(threadCount * sizeof(JobQueue), alignof(JobQueue), allocator.context));
+
+	// JobSystem is over-aligned because of the worker groups
+	auto js = new (allocator.alloc(sizeof(JobSystem), alignof(JobSystem), allocator.context)) JobSystem;
 	js->jobsPerThread = numJobsPerThread;
 	js->threadCount = threadCount;
 	js->jobPool = jobPool;
+	js->jobPoolMemory = jobPoolMemory;
 	js->jobIdPool = jobIdPool;
 	js->jobCapacity = jobCapacity;
+	js->spillPool = spillPool;
+	js->spillBlockInUse = spillBlockInUse;
+	js->spillBlocksPerThread = spillBlocksPerThread;
+	js->queues = queues;
+	js->readyThreadCount = 0;
 	js->allocator = allocator;
 	js->isRunning = true;
+	js->settings = settings;
+	js->settings.numJobsPerThread = numJobsPerThread;
+	js->settings.numWorkerThreads = numWorkerThreads;
+	js->settings.numBackgroundThreads = numBackgroundThreads;
+	js->frameWorkers.firstThread = 1;
+	js->frameWorkers.threadCount = numWorkerThreads;
+	js->backgroundWorkers.firstThread = 1 + numWorkerThreads;
+	js->backgroundWorkers.threadCount = numBackgroundThreads;
+	// Workers start searching for jobs
+	js->frameWorkers.searchingThreadCount = static_cast<int32_t>(numWorkerThreads);
+	js->backgroundWorkers.searchingThreadCount = static_cast<int32_t>(numBackgroundThreads);
 
 	// Init worker threads and queues
 	js->workerThreads.reserve(threadCount - 1);
 
-	if (threadCount > 1) {
-		// Init uniform random distribution
-		using param_t = std::uniform_int_distribution<>::param_type;
-		js->dist.param(param_t { 1, (int)threadCount - 1 });
-	}
-
-	for (size_t i = 0; i < threadCount; ++i) {
-		JobQueue& q = js->queues[i];
-		q.jobIds = jobIdPool + i * numJobsPerThread;
-		q.jobPoolOffset = i * numJobsPerThread;
-		q.jobPoolCapacity = numJobsPerThread;
-		q.jobPoolMask = numJobsPerThread - 1;
-		q.top = 0;
-		q.bottom = 0;
-		q.jobIndex = 0;
-		q.index = i;
-		q.stats = {};
-		if (i == 0) {
-			// Main thread
-			q.threadId = std::this_thread::get_id();
-		}
-		else {
-			// Worker thread
-			js->workerThreads.emplace_back(worker, std::ref(q), i, std::ref(*js));
-		}
-#if TY_JS_PROFILE
-		q.startTime = std::chrono::steady_clock::now();
-#endif
+	const uint32_t randomSeed = std::random_device {}();
+	const auto     threadLocations = getThreadLocations(settings, threadCount);
+	initThread(*js, 0, randomSeed, threadLocations); // main thread
+	for (size_t i = 1; i < threadCount; ++i) {
+		js->workerThreads.emplace_back(workerMain, std::ref(*js), i, randomSeed, std::cref(threadLocations));
 	}
+	waitForReadyThreads(*js);
 
 	jobSystem = js;
 }
 
 void destroyJobSystem() {
 	if (jobSystem) {
-		JobSystemAllocator allocator = jobSystem->allocator;
+		const JobSystemAllocator allocator = jobSystem->allocator;
 		stopThreads(*jobSystem);
-		allocator.free(jobSystem->jobPoolMemory);
-		allocator.free(jobSystem->jobIdPool);
+		tl_threadIndex = externalThreadIndex; // the queue of the calling thread is destroyed
+		const size_t threadCount = jobSystem->threadCount;
+		const size_t jobCapacity = jobSystem->jobCapacity;
+		for (size_t i = 0; i < threadCount; ++i) {
+			jobSystem->queues[i].~JobQueue();
+		}
+		allocator.free(jobSystem->queues, threadCount * sizeof(JobQueue), alignof(JobQueue), allocator.context);
+		freeJobPool(jobSystem->jobPool, jobCapacity * sizeof(Job), jobSystem->jobPoolMemory, allocator);
+		allocator.free(jobSystem->jobIdPool, jobCapacity * jobPriorityCount * sizeof(std::atomic<JobId>), pageSize, allocator.context);
+		if (jobSystem->spillPool) {
+			const size_t spillBlockCount = threadCount * jobSystem->spillBlocksPerThread;
+			allocator.free(jobSystem->spillPool, spillBlockCount * spillBlockSize, pageSize, allocator.context);
+			allocator.free(jobSystem->spillBlockInUse, spillBlockCount * sizeof(std::atomic_bool), alignof(std::atomic_bool), allocator.context);
+		}
 		jobSystem->~JobSystem();
-		allocator.free(jobSystem);
+		allocator.free(jobSystem, sizeof(JobSystem), alignof(JobSystem), allocator.context);
 		jobSystem = nullptr;
 	}
 }
 
+JobPoolMemory getJobPoolMemory() {
+	assert(jobSystem);
+	return jobSystem->jobPoolMemory;
+}
+
 size_t getWorkerThreadCount() {
 	assert(jobSystem);
-	return jobSystem->workerThreads.size();
+	return jobSystem->frameWorkers.threadCount;
+}
+
+size_t getBackgroundThreadCount() {
+	assert(jobSystem);
+	return jobSystem->backgroundWorkers.threadCount;
 }
 
 JobId createJob() {
@@ -365,6 +1321,10 @@ JobId createChildJob(JobId parent, JobFunction function) {
 
 void startJob(JobId jobId) {
 	assert(jobSystem);
+	if (! jobId) {
+		assert(false && "Null job identifier. The job pool was full when the job was created");
+		return;
+	}
 	JobSystem& js = *jobSystem;
 #ifdef _DEBUG
 	Job& job = getJob(js.jobPool, jobId);
@@ -378,22 +1338,73 @@ void startJob(JobId jobId) {
 	pushJob(queue, jobId, js);
 }
 
+void startJobs(const JobId* jobIds, size_t count) {
+	assert(jobSystem);
+	assert(jobIds || count == 0);
+	if (count == 0) {
+		return;
+	}
+	JobSystem& js = *jobSystem;
+	JobQueue&  queue = getThisThreadQueue(js);
+	for (size_t i = 0; i < count; ++i) {
+		if (! jobIds[i]) {
+			assert(false && "Null job identifier. The job pool was full when the job was created");
+			continue;
+		}
+		assert(&getQueue(jobIds[i], js) == &queue); // jobs created by this thread
+#ifdef _DEBUG
+		Job& job = getJob(js.jobPool, jobIds[i]);
+		assert(job.started == false);
+		assert(job.isContinuation == false); // cannot start manually a continuation
+		job.started = true;
+#endif
+	}
+	pushJobs(queue, jobIds, count, js);
+}
+
+JobBatch::~JobBatch() {
+	flush();
+}
+
+void JobBatch::add(JobId jobId) {
+	if (! jobId) {
+		return;
+	}
+	jobIds[count++] = jobId;
+	if (count == jobBatchCapacity) {
+		flush();
+	}
+}
+
+void JobBatch::flush() {
+	if (count == 0) {
+		// Nothing to start, e.g. an empty batch on a thread without a queue
+		return;
+	}
+	startJobs(jobIds, count);
+	count = 0;
+}
+
 void waitForJob(JobId jobId) {
-	assert(jobId);
 	assert(jobSystem);
+	if (! jobId) {
+		assert(false && "Null job identifier. The job pool was full when the job was created");
+		return;
+	}
 	JobSystem& js = *jobSystem;
 
-	JobQueue& queue = getQueue(jobId, js);
-	assert(queue.threadId == std::this_thread::get_id()); // only the thread that created a job can wait for it
+	if (tl_threadIndex == externalThreadIndex) {
+		// This thread cannot execute jobs
+		blockUntilFinished(js, jobId);
+		return;
+	}
+	// Help executing pending jobs, then block
+	JobQueue& queue = getThisThreadQueue(js);
+	IdleState idle;
 	while (! isJobFinished(js, jobId)) {
-		if (JobId nextJob = getNextJob(queue, js); nextJob) {
-			executeJob(nextJob, js, queue);
-			++queue.stats.numExecutedJobs;
-		}
-		else {
-			std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
-		}
+		executeNextJob(queue, js, idle, jobId);
 	}
+	resetIdleState(idle, queue.stats);
 }
 
 void startAndWaitForJob(JobId jobId) {
@@ -404,11 +1415,15 @@ void startAndWaitForJob(JobId jobId) {
 void startFunction(JobId parentJobId, JobLambda&& lambda) {
 	assert(jobSystem);
 
-	const JobId jobId = detail::createChildJobImpl(parentJobId, nullFunction, nullptr, 0);
-	Job&        job = getJob(jobSystem->jobPool, jobId);
-	static_assert(sizeof job.data >= sizeof(JobLambda) + alignof(JobLambda) - 1);
-	// in-place move construct lambda into Job::data
-	void* const ptr = detail::alignPointer(job.data, alignof(JobLambda));
+	const JobId jobId = detail::createChildJobImpl(parentJobId, nullFunction, nullptr, lambdaStorageSize);
+	if (! jobId) {
+		// The job pool is full. Execute the lambda on this thread
+		lambda(getThisThreadQueue(*jobSystem).index);
+		return;
+	}
+	Job& job = getJob(jobSystem->jobPool, jobId);
+	// in-place move construct lambda into the job data
+	void* const ptr = detail::alignPointer(getJobData(job), alignof(JobLambda));
 	new (ptr) JobLambda { std::move(lambda) };
 	job.isLambda = true;
 	startJob(jobId);
@@ -419,18 +1434,49 @@ JobId addContinuation(JobId job, JobFunction function) {
 }
 
 JobId addContinuation(JobId job, JobLambda&& lambda) {
-	const JobId continuationId = detail::addContinuationImpl(job, nullFunction, nullptr, 0);
-	Job&        continuation = getJob(jobSystem->jobPool, continuationId);
-	static_assert(sizeof continuation.data >= sizeof(JobLambda) + alignof(JobLambda) - 1);
-	// in-place move construct lambda into Job::data
-	void* const ptr = detail::alignPointer(continuation.data, alignof(JobLambda));
+	const JobId continuationId = detail::addContinuationImpl(job, nullFunction, nullptr, lambdaStorageSize);
+	if (! continuationId) {
+		return nullJobId;
+	}
+	Job& continuation = getJob(jobSystem->jobPool, continuationId);
+	// in-place move construct lambda into the job data
+	void* const ptr = detail::alignPointer(getJobData(continuation), alignof(JobLambda));
 	new (ptr) JobLambda { std::move(lambda) };
 	continuation.isLambda = true;
 	return continuationId;
 }
 
+bool addDependency(JobId jobId, JobId predecessorId) {
+	assert(jobSystem);
+	assert(jobId != predecessorId);
+	if (! jobId || ! predecessorId) {
+		assert(false && "Null job identifier. The job pool was full when the job was created");
+		return false;
+	}
+	JobSystem& js = *jobSystem;
+
+	// The link is a job holding the dependent job, added to the continuations of the predecessor. It is never executed
+	const JobId linkId = detail::createJobImpl(dependencyLinkFunction, &jobId, sizeof jobId);
+	if (! linkId) {
+		return false;
+	}
+	Job& job = getJob(js.jobPool, jobId);
+	Job& predecessor = getJob(js.jobPool, predecessorId);
+#ifdef _DEBUG
+	assert(job.started == false);
+	assert(predecessor.started == false);
+	job.isContinuation = true; // started by its last predecessor
+#endif
+	++job.pendingPredecessors;
+	appendContinuation(js, predecessor, linkId);
+	return true;
+}
+
 ThreadStats getThreadStats(size_t threadIdx) {
 	auto& queue = jobSystem->queues[threadIdx];
+#if TY_JS_STEALING
+	queue.stats.numGivenJobs = queue.givenJobCount.load(std::memory_order_relaxed);
+#endif
 #if TY_JS_PROFILE
 	const auto endTime = std::chrono::steady_clock::now();
 	queue.stats.totalTime = std::chrono::duration_cast<std::chrono::microseconds>(endTime - queue.startTime);
@@ -446,33 +1492,63 @@ namespace detail {
 
 JobId createJobImpl(JobFunction function, const void* data, size_t dataSize) {
 	assert(function);
-	assert(dataSize <= sizeof(Job::data));
+	assert(dataSize <= maxJobDataSize);
 	assert(data == nullptr || dataSize);
 
 	JobSystem& js = *jobSystem;
 
-	JobQueue&   queue = getThisThreadQueue(js);
-	const JobId jobId = static_cast<JobId>(1 + queue.jobPoolOffset + queue.jobIndex);
-	queue.jobIndex = (queue.jobIndex + 1) & queue.jobPoolMask; // ring buffer
-	assert(jobId <= js.jobCapacity);
-	Job& job = getJob(js.jobPool, jobId);
+	JobQueue& queue = getThisThreadQueue(js);
+	// Arguments that do not fit in the job go to a spill block
+	// The block is allocated first: a job is not reserved until it is initialized, and the jobs executed while waiting for a block
+	// could be given the same job
+	const bool spill = dataSize > sizeof(Job::data);
+	size_t     spillBlockIndex = 0;
+	if (spill && ! allocateWithOverflowPolicy(queue, js, queue.stats.numSpillPoolOverflows,
+	                                          [&] { return allocateSpillBlock(queue, js, spillBlockIndex); })) {
+		return nullJobId;
+	}
+	char* const spillBlock = spill ? js.spillPool + spillBlockIndex * spillBlockSize : nullptr;
+	size_t      jobIndex = 0;
+	if (! allocateWithOverflowPolicy(queue, js, queue.stats.numJobPoolOverflows, [&] { return allocateJob(queue, js, jobIndex); })) {
+		if (spillBlock) {
+			releaseSpillBlock(js, spillBlock);
+		}
+		return nullJobId;
+	}
+	assert(jobIndex < js.jobCapacity);
+#if TY_JS_PROFILE
+	// The count is approximate, as the finished count is incremented after the job is released
+	const size_t liveJobCount = ++queue.createdJobCount - queue.finishedJobCount.load(std::memory_order_relaxed);
+	queue.stats.maxLiveJobs = std::max(queue.stats.maxLiveJobs, std::min(liveJobCount, queue.jobPoolCapacity));
+#endif
+	Job& job = js.jobPool[jobIndex];
+#if TY_JS_WIDE_JOB_ID
+	// Invalidate identifiers of the previous use of the job
+	job.generation.store(job.generation.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+#endif
+	const JobId jobId = makeJobId(jobIndex, job);
 #ifdef _DEBUG
 	job.isContinuation = false;
 	job.started = false;
-	assert(job.unfinished == 0 && "Job queue is full"); // catch full queue
 #endif
 	job.func = function;
 	job.parent = nullJobId;
 	job.continuation = nullJobId;
 	job.next = nullJobId;
 	job.unfinished = 1;
+	job.pendingPredecessors = 0;
 	job.isLambda = false;
+	job.hasSpilledData = spill;
+	job.priority = JobPriority::normal;
+	if (spill) {
+		std::memcpy(job.data, &spillBlock, sizeof spillBlock);
+	}
 	if (data) {
-		std::memcpy(job.data, data, dataSize);
+		std::memcpy(getJobData(job), data, dataSize);
 	}
 	else {
 #if _DEBUG
-		std::memset(job.data, 0, sizeof job.data);
+		std::memset(getJobData(job), 0, spill ? spillBlockSize : sizeof job.data);
 #endif
 	}
 	return jobId;
@@ -481,66 +1557,138 @@ JobId createJobImpl(JobFunction function, const void* data, size_t dataSize) {
 JobId createChildJobImpl(JobId parent, JobFunction function, const void* data, size_t dataSize) {
 	JobSystem& js = *jobSystem;
 	JobId      jobId = createJobImpl(function, data, dataSize);
-	Job&       job = getJob(js.jobPool, jobId);
+	if (! jobId) {
+		return nullJobId;
+	}
+	Job& job = getJob(js.jobPool, jobId);
 	job.parent = parent;
 	if (parent) {
 		Job& parentJob = getJob(js.jobPool, parent);
 		assert(parentJob.unfinished > 0); // it cannot have finished already
 		++parentJob.unfinished;
+		job.priority = parentJob.priority;
 	}
 	return jobId;
 }
 
 JobId addContinuationImpl(JobId previousJobId, JobFunction function, const void* data, size_t dataSize) {
 	assert(jobSystem);
-	assert(previousJobId != nullJobId);
 	assert(function);
+	if (! previousJobId) {
+		assert(false && "Null job identifier. The job pool was full when the job was created");
+		return nullJobId;
+	}
 
-	Job& previousJob = getJob(jobSystem->jobPool, previousJobId);
+	Job& previousJob = jobSystem->jobPool[getJobIndex(previousJobId)];
+	if (! isCurrentJob(previousJob, previousJobId)) {
+		assert(false && "Stale job identifier");
+		return nullJobId;
+	}
+#ifdef _DEBUG
 	assert(previousJob.started == false);
+#endif
 
 	const JobId continuationId = createChildJobImpl(previousJob.parent, function, data, dataSize);
+	if (! continuationId) {
+		return nullJobId;
+	}
+	Job& continuation = getJob(jobSystem->jobPool, continuationId);
+	// Continuations of background jobs go back to the frame workers
+	continuation.priority = previousJob.priority == JobPriority::background ? JobPriority::normal : previousJob.priority;
 #if _DEBUG
-	getJob(jobSystem->jobPool, continuationId).isContinuation = true;
+	continuation.isContinuation = true;
 #endif
 
-	// Add continuation to linked list
-	if (! previousJob.continuation) {
-		previousJob.continuation = continuationId;
-	}
-	else {
-		JobId iter = previousJob.continuation;
-		while (jobSystem->jobPool[iter].next) {
-			iter = jobSystem->jobPool[iter].next;
-		}
-		jobSystem->jobPool[iter].next = continuationId;
-	}
+	appendContinuation(*jobSystem, previousJob, continuationId);
 	return continuationId;
 }
 
+void setJobPriorityImpl(JobId jobId, JobPriority priority) {
+	assert(jobSystem);
+	assert(static_cast<size_t>(priority) < jobPriorityCount);
+	Job& job = getJob(jobSystem->jobPool, jobId);
+#ifdef _DEBUG
+	assert(job.started == false); // the job is already in a queue
+#endif
+	job.priority = priority;
+}
+
+JobPriority getJobPriorityImpl(JobId jobId) {
+	assert(jobSystem);
+	return getJob(jobSystem->jobPool, jobId).priority;
+}
+
+void retainJobImpl(JobId jobId) {
+	assert(jobSystem);
+	Job& job = getJob(jobSystem->jobPool, jobId);
+	assert(job.unfinished > 0); // it cannot have finished already
+	++job.unfinished;
+}
+
+void releaseJobImpl(JobId jobId) {
+	assert(jobSystem);
+	JobSystem& js = *jobSystem;
+	JobQueue&  queue = getThisThreadQueue(js);
+	if (const JobId readyJob = finishJob(js, jobId, queue); readyJob) {
+		pushJob(queue, readyJob, js);
+	}
+}
+
+void* getJobDataImpl(JobId jobId) {
+	assert(jobSystem);
+	assert(jobId != nullJobId);
+	return getJobData(getJob(jobSystem->jobPool, jobId));
+}
+
 void parallelForImpl(const JobParams& prm) {
 	ParallelForJobData data;
 	std::memcpy(&data, prm.args, sizeof data); // copy to avoid misalignment
-	if (data.count > data.splitThreshold) {
-		// split in two
-		const uint32_t     leftCount = data.count / 2u;
-		ParallelForJobData leftData { data.function, data.splitThreshold, data.offset, leftCount, {} };
-		std::memcpy(leftData.functionArgs, data.functionArgs, sizeof leftData.functionArgs);
-		JobId left = createChildJob(prm.job, parallelForImpl, leftData);
-		startJob(left);
-
-		const uint32_t     rightCount = data.count - leftCount;
-		ParallelForJobData rightData { data.function, data.splitThreshold, data.offset + leftCount, rightCount, {} };
-		std::memcpy(rightData.functionArgs, data.functionArgs, sizeof rightData.functionArgs);
-		JobId right = createChildJob(prm.job, parallelForImpl, rightData);
-		startJob(right);
-	}
-	else {
+
+	auto spawn = [&prm, &data](size_t begin, size_t end) {
+		ParallelForJobData childData { data.function, data.splitThreshold, static_cast<uint32_t>(begin), static_cast<uint32_t>(end - begin), {} };
+		std::memcpy(childData.functionArgs, data.functionArgs, sizeof childData.functionArgs);
+		if (JobId child = createChildJob(prm.job, parallelForImpl, childData); child) {
+			startJob(child);
+		}
+		else {
+			// The job pool is full. Process the range on this thread
+			const JobParams childPrm { prm.job, prm.threadIndex, &childData };
+			parallelForImpl(childPrm);
+		}
+	};
+	auto process = [&prm, &data](size_t begin, size_t end) {
 		// execute the function on the range of data
-		(data.function)(data.offset, data.count, data.functionArgs, prm.threadIndex);
+		(data.function)(begin, end - begin, data.functionArgs, prm.threadIndex);
+	};
+	splitRange(data.offset, static_cast<size_t>(data.offset) + data.count, data.splitThreshold, 1, spawn, process);
+}
+
+void runRangeLoop(RangeLoop& loop, JobId job, size_t begin, size_t end, size_t threadIndex) {
+	auto spawn = [&loop, job, threadIndex](size_t childBegin, size_t childEnd) {
+		loop.pendingRangeCount.fetch_add(1, std::memory_order_relaxed);
+		if (JobId child = createChildJob(job, rangeLoopJob, &loop, childBegin, childEnd); child) {
+			startJob(child);
+		}
+		else {
+			// The job pool is full. Process the range on this thread
+			runRangeLoop(loop, job, childBegin, childEnd, threadIndex);
+		}
+	};
+	auto process = [&loop, threadIndex](size_t chunkBegin, size_t chunkEnd) {
+		loop.invoke(loop, chunkBegin, chunkEnd, threadIndex);
+	};
+	splitRange(begin, end, loop.grainSize, loop.chunkAlignment, spawn, process);
+	// The last range destroys the loop body
+	if (loop.pendingRangeCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		loop.destroy(loop);
 	}
 }
 
+void rangeLoopJob(const JobParams& prm) {
+	auto [loop, begin, end] = unpackJobArgs<RangeLoop*, size_t, size_t>(prm.args);
+	runRangeLoop(*loop, prm.job, begin, end, prm.threadIndex);
+}
+
 } // namespace detail
 
 } // namespace Jobs
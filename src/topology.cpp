@@ -0,0 +1,178 @@
+#include "topology.h"
+#include <algorithm>
+#include <cstdio>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace Typhoon {
+
+namespace Jobs {
+
+namespace detail {
+
+#ifdef __linux__
+
+namespace {
+
+// Reads the first line of a sysfs file. Returns false if the file does not exist
+bool readLine(const char* path, char* buffer, int bufferSize) {
+	std::FILE* file = std::fopen(path, "r");
+	if (! file) {
+		return false;
+	}
+	const bool res = std::fgets(buffer, bufferSize, file) != nullptr;
+	std::fclose(file);
+	return res;
+}
+
+// Parses a CPU or node list such as "0-3,8,10-11"
+bool readList(const char* path, std::vector<int>& values) {
+	char buffer[4096];
+	if (! readLine(path, buffer, static_cast<int>(sizeof buffer))) {
+		return false;
+	}
+	values.clear();
+	const char* str = buffer;
+	int         first = 0;
+	int         last = 0;
+	int         length = 0;
+	while (std::sscanf(str, "%d%n", &first, &length) == 1) {
+		str += length;
+		last = first;
+		if (*str == '-' && std::sscanf(str + 1, "%d%n", &last, &length) == 1) {
+			str += 1 + length;
+		}
+		for (int value = first; value <= last; ++value) {
+			values.push_back(value);
+		}
+		if (*str != ',') {
+			break;
+		}
+		++str;
+	}
+	return ! values.empty();
+}
+
+// Returns the lowest CPU sharing the last level cache with a CPU, or -1 if unknown
+int readCacheId(int cpu) {
+	char             path[128];
+	char             line[16];
+	int              cacheId = -1;
+	int              maxLevel = 0;
+	std::vector<int> sharedCpus;
+	for (int index = 0;; ++index) {
+		std::snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+		if (! readLine(path, line, static_cast<int>(sizeof line))) {
+			break;
+		}
+		int level = 0;
+		if (std::sscanf(line, "%d", &level) != 1) {
+			continue;
+		}
+		std::snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+		if (level > maxLevel && readList(path, sharedCpus)) {
+			maxLevel = level;
+			cacheId = sharedCpus.front();
+		}
+	}
+	return cacheId;
+}
+
+} // namespace
+
+bool readCpuTopology(std::vector<CpuLocation>& cpus) {
+	std::vector<int> onlineCpus;
+	if (! readList("/sys/devices/system/cpu/online", onlineCpus)) {
+		return false;
+	}
+	cpu_set_t allowedCpus;
+	CPU_ZERO(&allowedCpus);
+	if (sched_getaffinity(0, sizeof allowedCpus, &allowedCpus) != 0) {
+		return false;
+	}
+
+	cpus.clear();
+	char             path[128];
+	std::vector<int> siblings;
+	for (int cpu : onlineCpus) {
+		if (cpu >= CPU_SETSIZE || ! CPU_ISSET(cpu, &allowedCpus)) {
+			continue;
+		}
+		CpuLocation location;
+		location.cpu = cpu;
+		location.cacheId = readCacheId(cpu);
+		std::snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+		if (readList(path, siblings)) {
+			location.smtIndex = static_cast<int>(std::find(siblings.begin(), siblings.end(), cpu) - siblings.begin());
+		}
+		cpus.push_back(location);
+	}
+
+	std::vector<int> nodes;
+	std::vector<int> nodeCpus;
+	if (readList("/sys/devices/system/node/online", nodes)) {
+		for (int node : nodes) {
+			std::snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+			if (! readList(path, nodeCpus)) {
+				continue;
+			}
+			for (CpuLocation& location : cpus) {
+				if (std::find(nodeCpus.begin(), nodeCpus.end(), location.cpu) != nodeCpus.end()) {
+					location.numaNode = node;
+				}
+			}
+		}
+	}
+
+	std::sort(cpus.begin(), cpus.end(), [](const CpuLocation& a, const CpuLocation& b) {
+		if (a.numaNode != b.numaNode) {
+			return a.numaNode < b.numaNode;
+		}
+		if (a.cacheId != b.cacheId) {
+			return a.cacheId < b.cacheId;
+		}
+		if (a.smtIndex != b.smtIndex) {
+			return a.smtIndex < b.smtIndex;
+		}
+		return a.cpu < b.cpu;
+	});
+	return ! cpus.empty();
+}
+
+int getCurrentCpu() {
+	return sched_getcpu();
+}
+
+bool pinThisThread(int cpu) {
+	if (cpu < 0 || cpu >= CPU_SETSIZE) {
+		return false;
+	}
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	CPU_SET(cpu, &cpuSet);
+	return sched_setaffinity(0, sizeof cpuSet, &cpuSet) == 0;
+}
+
+#else
+
+bool readCpuTopology(std::vector<CpuLocation>& /*cpus*/) {
+	return false;
+}
+
+int getCurrentCpu() {
+	return -1;
+}
+
+bool pinThisThread(int /*cpu*/) {
+	return false;
+}
+
+#endif
+
+} // namespace detail
+
+} // namespace Jobs
+
+} // namespace Typhoon
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+namespace Typhoon {
+
+namespace Jobs {
+
+namespace detail {
+
+// Location of a logical CPU in the memory hierarchy
+struct CpuLocation {
+	int cpu = -1;      // logical CPU index
+	int cacheId = -1;  // lowest logical CPU sharing the last level cache with this one, -1 if unknown
+	int numaNode = -1; // -1 if unknown
+	int smtIndex = 0;  // index of the logical CPU among the hardware threads of its core
+};
+
+// Reads the location of the CPUs the process can run on from /sys/devices/system/cpu
+// CPUs are sorted by NUMA node, by last level cache, then by hardware thread, so that consecutive CPUs are close
+// and the first hardware thread of each core comes before its siblings
+// Returns false if the topology is not available (Linux only)
+bool readCpuTopology(std::vector<CpuLocation>& cpus);
+
+// Returns the logical CPU the calling thread is running on, or -1 if unknown
+int getCurrentCpu();
+
+// Restricts the calling thread to a logical CPU. Returns false on failure or if not supported
+bool pinThisThread(int cpu);
+
+} // namespace detail
+
+} // namespace Jobs
+
+} // namespace Typhoon
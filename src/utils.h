@@ -1,5 +1,14 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TY_JS_X86 1
+#elif defined(_M_ARM64)
+#include <intrin.h>
+#endif
+
 namespace Typhoon {
 
 namespace Jobs {
@@ -29,6 +38,42 @@ inline constexpr uint32_t nextPowerOfTwo(uint32_t v) {
 	return v;
 }
 
+// Scrambles a seed into a non-zero state for xorshift32
+inline uint32_t hashSeed(uint32_t seed) {
+	seed = (seed ^ 61u) ^ (seed >> 16);
+	seed *= 9u;
+	seed ^= seed >> 4;
+	seed *= 0x27d4eb2du;
+	seed ^= seed >> 15;
+	return seed ? seed : 1u;
+}
+
+// Fast pseudo-random number generator (Marsaglia's xorshift32). state must be non-zero
+inline uint32_t xorshift32(uint32_t& state) {
+	uint32_t x = state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	state = x;
+	return x;
+}
+
+// Returns a pseudo-random number in [0, range) (Lemire's multiply-shift reduction)
+inline uint32_t randomRange(uint32_t& state, uint32_t range) {
+	return static_cast<uint32_t>((static_cast<uint64_t>(xorshift32(state)) * range) >> 32);
+}
+
+// Hint to the CPU that the calling thread is spinning
+inline void cpuPause() {
+#if TY_JS_X86
+	_mm_pause();
+#elif defined(_M_ARM64)
+	__yield();
+#elif defined(__aarch64__) || defined(__arm__)
+	asm volatile("yield");
+#endif
+}
+
 } // namespace detail
 
 } // namespace Jobs
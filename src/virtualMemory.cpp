@@ -0,0 +1,70 @@
+#include "virtualMemory.h"
+#include "utils.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace Typhoon {
+
+namespace Jobs {
+
+namespace detail {
+
+namespace {
+
+size_t roundToHugePages(size_t size) {
+	return (size + hugePageSize - 1) & ~(hugePageSize - 1);
+}
+
+} // namespace
+
+#ifdef __linux__
+
+void* mapHugePages(size_t size, bool hugeTlb) {
+	size = roundToHugePages(size);
+	if (hugeTlb) {
+		void* const ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		return ptr == MAP_FAILED ? nullptr : ptr;
+	}
+	// Over-map by a huge page, then trim the mapping to a huge page boundary
+	const size_t mappedSize = size + hugePageSize;
+	void* const  ptr = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED) {
+		return nullptr;
+	}
+	char* const begin = static_cast<char*>(ptr);
+	char* const end = begin + mappedSize;
+	char* const alignedBegin = static_cast<char*>(alignPointer(ptr, hugePageSize));
+	char* const alignedEnd = alignedBegin + size;
+	if (alignedBegin != begin) {
+		munmap(begin, alignedBegin - begin);
+	}
+	if (alignedEnd != end) {
+		munmap(alignedEnd, end - alignedEnd);
+	}
+	// Not an error if transparent huge pages are disabled
+	madvise(alignedBegin, size, MADV_HUGEPAGE);
+	return alignedBegin;
+}
+
+void unmapHugePages(void* ptr, size_t size) {
+	munmap(ptr, roundToHugePages(size));
+}
+
+#else
+
+void* mapHugePages(size_t /*size*/, bool /*hugeTlb*/) {
+	return nullptr;
+}
+
+void unmapHugePages(void* /*ptr*/, size_t /*size*/) {
+}
+
+#endif
+
+} // namespace detail
+
+} // namespace Jobs
+
+} // namespace Typhoon
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Typhoon {
+
+namespace Jobs {
+
+namespace detail {
+
+// Size of a huge page
+constexpr size_t hugePageSize = 2 * 1024 * 1024;
+
+// Maps zero-initialized memory backed by huge pages. The size is rounded up to a multiple of hugePageSize
+// With hugeTlb the pages come from the huge pages reserved by the system (see /proc/sys/vm/nr_hugepages),
+// otherwise the mapping is aligned to a huge page boundary and transparent huge pages are requested
+// Returns nullptr on failure or if not supported (Linux only)
+void* mapHugePages(size_t size, bool hugeTlb);
+
+// Unmaps memory returned by mapHugePages
+void unmapHugePages(void* ptr, size_t size);
+
+} // namespace detail
+
+} // namespace Jobs
+
+} // namespace Typhoon
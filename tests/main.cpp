@@ -1,8 +1,15 @@
 #include "../examples/common.h"
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <jobSystem/jobGraph.h>
 #include <jobSystem/jobSystem.h>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
 #include <thread>
+#include <vector>
 
 #define CATCH_CONFIG_RUNNER
 #include <Catch-master/single_include/catch2/catch.hpp>
@@ -209,6 +216,17 @@ JobId simulateGameFrame(Test& test) {
 	return rootJob;
 }
 
+// Custom allocator tracking memory. context points to the allocated size
+void* trackingAlloc(size_t size, size_t alignment, void* context) {
+	*static_cast<size_t*>(context) += size;
+	return ::operator new(size, std::align_val_t { alignment });
+}
+
+void trackingFree(void* ptr, size_t size, size_t alignment, void* context) {
+	*static_cast<size_t*>(context) -= size;
+	::operator delete(ptr, std::align_val_t { alignment });
+}
+
 } // namespace
 
 TEST_CASE("Jobs") {
@@ -217,11 +235,6 @@ TEST_CASE("Jobs") {
 
 	// Custom allocator tracking memory
 	size_t memory = 0;
-	auto   customAlloc = [&memory](size_t size) {
-        memory += size;
-        return malloc(size);
-	};
-	auto customFree = [](void* ptr) { free(ptr); };
 
 	SECTION("Single Threaded") {
 		numWorkerThreads = 0;
@@ -233,8 +246,9 @@ TEST_CASE("Jobs") {
 	print("Jobs");
 	print("Worker threads: %zd", numWorkerThreads);
 
-	const JobSystemAllocator allocator { customAlloc, customFree };
+	const JobSystemAllocator allocator { trackingAlloc, trackingFree, &memory };
 	initJobSystem(test.maxJobs, numWorkerThreads, allocator);
+	CHECK(memory > 0);
 
 	std::atomic_store<size_t>(&completeCount, 0);
 
@@ -252,6 +266,7 @@ TEST_CASE("Jobs") {
 	printStats();
 
 	destroyJobSystem();
+	CHECK(memory == 0);
 }
 
 TEST_CASE("Lambdas") {
@@ -293,6 +308,61 @@ TEST_CASE("Lambdas") {
 	destroyJobSystem();
 }
 
+TEST_CASE("Move-only lambdas") {
+	initJobSystem(defaultMaxJobs, std::thread::hardware_concurrency() - 1);
+
+	std::atomic_store<size_t>(&completeCount, 0);
+	auto        sharedState = std::make_shared<int>(0);
+	const JobId rootJob = createJob();
+	for (int i = 0; i < 100; ++i) {
+		auto missile = std::make_unique<int>(i);
+		startFunction(rootJob, [missile = std::move(missile), sharedState]([[maybe_unused]] size_t threadIndex) { launchMissile(*missile, 0.f); });
+	}
+	const JobId continuationJob = addContinuation(rootJob, [sharedState]([[maybe_unused]] size_t threadIndex) {});
+	startAndWaitForJob(rootJob);
+	waitForJob(continuationJob);
+	CHECK(std::atomic_load(&completeCount) == 100);
+	// The captures of the executed lambdas have been destroyed
+	CHECK(sharedState.use_count() == 1);
+
+	destroyJobSystem();
+}
+
+struct MissileLauncher {
+	std::unique_ptr<int> missile;
+
+	void operator()(float velocity) const {
+		launchMissile(*missile, velocity);
+	}
+};
+
+TEST_CASE("Callables") {
+	initJobSystem(defaultMaxJobs, std::thread::hardware_concurrency() - 1);
+
+	std::atomic_store<size_t>(&completeCount, 0);
+	auto        sharedState = std::make_shared<int>(0);
+	const JobId rootJob = createJob();
+	for (int i = 0; i < 100; ++i) {
+		// Free function with arguments
+		startJob(createChildJob(rootJob, launchMissile, i, 1.f));
+		// Function object, move-only
+		startJob(createChildJob(rootJob, MissileLauncher { std::make_unique<int>(i) }, 1.f));
+		// Lambda with non-trivial arguments
+		const JobId job = createChildJob(
+		    rootJob, [](std::shared_ptr<int> state, std::unique_ptr<int> missile) { launchMissile(*missile + *state, 1.f); }, sharedState,
+		    std::make_unique<int>(i));
+		startJob(job);
+	}
+	const JobId continuationJob = addContinuation(rootJob, [sharedState]() { (void)sharedState; });
+	startAndWaitForJob(rootJob);
+	waitForJob(continuationJob);
+	CHECK(std::atomic_load(&completeCount) == 300);
+	// Callables and arguments have been destroyed
+	CHECK(sharedState.use_count() == 1);
+
+	destroyJobSystem();
+}
+
 TEST_CASE("Parallel") {
 	size_t numWorkerThreads = 0;
 	Test   test;
@@ -332,6 +402,229 @@ TEST_CASE("Parallel") {
 	destroyJobSystem();
 }
 
+void markElements(size_t offset, size_t count, const void* args, [[maybe_unused]] size_t threadIndex) {
+	auto visitCounts = unpackJobArg<std::atomic_int*>(args);
+	for (size_t i = offset; i < offset + count; ++i) {
+		visitCounts[i].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+size_t runParallelForJobs(ParallelForSplitMode splitMode, size_t numWorkerThreads) {
+	constexpr size_t elementCount = 1 << 16;
+	constexpr size_t splitThreshold = 64;
+
+	JobSystemSettings settings;
+	settings.numWorkerThreads = numWorkerThreads;
+	settings.parallelForSplitMode = splitMode;
+	initJobSystem(settings);
+
+	static std::atomic_int visitCounts[elementCount];
+	for (auto& visitCount : visitCounts) {
+		visitCount = 0;
+	}
+	const JobId loopJob = parallelFor(nullJobId, splitThreshold, markElements, elementCount, &visitCounts[0]);
+	startAndWaitForJob(loopJob);
+
+	bool allVisitedOnce = true;
+	for (const auto& visitCount : visitCounts) {
+		allVisitedOnce &= (visitCount == 1);
+	}
+	CHECK(allVisitedOnce);
+
+	size_t executedJobs = 0;
+	for (size_t i = 0; i <= getWorkerThreadCount(); ++i) {
+		executedJobs += getThreadStats(i).numExecutedJobs;
+	}
+	destroyJobSystem();
+	return executedJobs;
+}
+
+TEST_CASE("Parallel for split modes") {
+	SECTION("Single Threaded") {
+		const size_t eagerJobs = runParallelForJobs(ParallelForSplitMode::eager, 0);
+		const size_t lazyJobs = runParallelForJobs(ParallelForSplitMode::lazy, 0);
+		print("Parallel for jobs. Eager: %zd Lazy: %zd", eagerJobs, lazyJobs);
+		CHECK(lazyJobs * 10 < eagerJobs);
+	}
+	SECTION("Multi Threaded") {
+		const size_t numWorkerThreads = std::thread::hardware_concurrency() - 1;
+		runParallelForJobs(ParallelForSplitMode::eager, numWorkerThreads);
+		runParallelForJobs(ParallelForSplitMode::lazy, numWorkerThreads);
+	}
+}
+
+TEST_CASE("Parallel for over a range") {
+	constexpr size_t begin = 3;
+	constexpr size_t end = 100000;
+	constexpr size_t grainSize = 100;
+	constexpr size_t chunkAlignment = 16;
+
+	JobSystemSettings settings;
+	settings.numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	SECTION("Eager") {
+		settings.parallelForSplitMode = ParallelForSplitMode::eager;
+	}
+	SECTION("Lazy") {
+		settings.parallelForSplitMode = ParallelForSplitMode::lazy;
+	}
+	initJobSystem(settings);
+
+	auto             visitCounts = std::make_shared<std::vector<std::atomic_int>>(end);
+	std::atomic_bool misalignedChunk = false;
+	auto             body = [visitCounts, &misalignedChunk](size_t chunkBegin, size_t chunkEnd) {
+		if (chunkBegin != begin && chunkBegin % chunkAlignment != 0) {
+			misalignedChunk = true;
+		}
+		for (size_t i = chunkBegin; i < chunkEnd; ++i) {
+			(*visitCounts)[i].fetch_add(1, std::memory_order_relaxed);
+		}
+	};
+	const JobId loopJob = parallelFor(nullJobId, begin, end, grainSize, std::move(body), chunkAlignment);
+	startAndWaitForJob(loopJob);
+
+	bool allVisitedOnce = true;
+	for (size_t i = 0; i < end; ++i) {
+		allVisitedOnce &= ((*visitCounts)[i] == (i >= begin ? 1 : 0));
+	}
+	CHECK(allVisitedOnce);
+	CHECK_FALSE(misalignedChunk);
+	// The loop body has been destroyed
+	CHECK(visitCounts.use_count() == 1);
+
+	destroyJobSystem();
+}
+
+TEST_CASE("Parallel for 2D and 3D") {
+	initJobSystem(defaultMaxJobs, std::thread::hardware_concurrency() - 1);
+
+	SECTION("2D") {
+		constexpr size_t sizeX = 1000;
+		constexpr size_t sizeY = 300;
+		constexpr size_t tileSize = 64;
+
+		std::vector<std::atomic_int> visitCounts(sizeX * sizeY);
+		std::atomic_bool             invalidTile = false;
+		auto                         body = [&](size_t beginX, size_t endX, size_t beginY, size_t endY) {
+			if (beginX % tileSize || beginY % tileSize || endX - beginX > tileSize || endY - beginY > tileSize) {
+				invalidTile = true;
+			}
+			for (size_t y = beginY; y < endY; ++y) {
+				for (size_t x = beginX; x < endX; ++x) {
+					visitCounts[y * sizeX + x].fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		};
+		startAndWaitForJob(parallelFor2D(nullJobId, sizeX, sizeY, tileSize, tileSize, body));
+		CHECK_FALSE(invalidTile);
+		CHECK(std::all_of(visitCounts.begin(), visitCounts.end(), [](const std::atomic_int& count) { return count == 1; }));
+	}
+	SECTION("3D") {
+		constexpr size_t sizeX = 70;
+		constexpr size_t sizeY = 50;
+		constexpr size_t sizeZ = 33;
+
+		std::vector<std::atomic_int> visitCounts(sizeX * sizeY * sizeZ);
+		auto body = [&](size_t beginX, size_t endX, size_t beginY, size_t endY, size_t beginZ, size_t endZ, [[maybe_unused]] size_t threadIndex) {
+			for (size_t z = beginZ; z < endZ; ++z) {
+				for (size_t y = beginY; y < endY; ++y) {
+					for (size_t x = beginX; x < endX; ++x) {
+						visitCounts[(z * sizeY + y) * sizeX + x].fetch_add(1, std::memory_order_relaxed);
+					}
+				}
+			}
+		};
+		startAndWaitForJob(parallelFor3D(nullJobId, sizeX, sizeY, sizeZ, 16, 8, 4, body));
+		CHECK(std::all_of(visitCounts.begin(), visitCounts.end(), [](const std::atomic_int& count) { return count == 1; }));
+	}
+
+	destroyJobSystem();
+}
+
+TEST_CASE("Parallel reduce and scan") {
+	constexpr size_t count = 100000;
+	constexpr size_t grainSize = 1000;
+
+	JobSystemSettings settings;
+	SECTION("Single Threaded") {
+		settings.numWorkerThreads = 0;
+	}
+	SECTION("Multi Threaded") {
+		settings.numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	}
+	initJobSystem(settings);
+
+	std::vector<int64_t> values(count);
+	for (size_t i = 0; i < count; ++i) {
+		values[i] = static_cast<int64_t>(i % 1000) - 300;
+	}
+
+	// Sum
+	int64_t     sum = 0;
+	const JobId sumJob = parallelReduce(
+	    nullJobId, 0, count, grainSize, int64_t { 0 },
+	    [&values](size_t begin, size_t end, int64_t init) { return std::accumulate(values.data() + begin, values.data() + end, init); },
+	    std::plus<int64_t> {}, &sum);
+	startAndWaitForJob(sumJob);
+	CHECK(sum == std::accumulate(values.begin(), values.end(), int64_t { 0 }));
+
+	// Non-commutative reduction: the order of the subranges is preserved
+	std::pair<size_t, size_t> span { 0, 0 };
+	auto                      concatenate = [](std::pair<size_t, size_t> left, std::pair<size_t, size_t> right) {
+        return std::make_pair(left.first, right.second);
+	};
+	const JobId spanJob = parallelReduce(
+	    nullJobId, 5, count, grainSize, std::pair<size_t, size_t> { 0, 0 },
+	    [](size_t begin, size_t end, std::pair<size_t, size_t> /*init*/) { return std::make_pair(begin, end); }, concatenate, &span);
+	// Swapped subranges would produce an empty span
+	startAndWaitForJob(spanJob);
+	CHECK(span == std::pair<size_t, size_t> { 5, count });
+
+	// Prefix sum
+	std::vector<int64_t> prefixSums(count);
+	const JobId          scanJob = parallelScan(nullJobId, values.data(), prefixSums.data(), count, grainSize, std::plus<int64_t> {});
+	startAndWaitForJob(scanJob);
+	std::vector<int64_t> expectedPrefixSums(count);
+	std::inclusive_scan(values.begin(), values.end(), expectedPrefixSums.begin());
+	CHECK(prefixSums == expectedPrefixSums);
+
+	// In place
+	const JobId inPlaceScanJob = parallelScan(nullJobId, values.data(), values.data(), count, 777, std::plus<int64_t> {});
+	startAndWaitForJob(inPlaceScanJob);
+	CHECK(values == expectedPrefixSums);
+
+	destroyJobSystem();
+}
+
+TEST_CASE("Parallel sort") {
+	constexpr size_t count = 100000;
+	constexpr size_t grainSize = 1000;
+
+	initJobSystem(defaultMaxJobs, std::thread::hardware_concurrency() - 1);
+
+	std::vector<uint64_t> keys(count);
+	uint64_t              seed = 12345;
+	for (uint64_t& key : keys) {
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+		key = (seed >> 33) % 50000; // with duplicates
+	}
+	std::vector<uint64_t> expectedKeys = keys;
+	std::sort(expectedKeys.begin(), expectedKeys.end());
+
+	SECTION("Scratch buffer") {
+		std::vector<uint64_t> scratch(count);
+		const JobId           sortJob = parallelSort(nullJobId, keys.begin(), keys.end(), grainSize, std::less<> {}, scratch.data());
+		startAndWaitForJob(sortJob);
+		CHECK(keys == expectedKeys);
+	}
+	SECTION("Allocated scratch buffer, custom comparison") {
+		const JobId sortJob = parallelSort(nullJobId, keys.data(), keys.data() + count, grainSize, std::greater<> {});
+		startAndWaitForJob(sortJob);
+		CHECK(std::equal(keys.begin(), keys.end(), expectedKeys.rbegin()));
+	}
+
+	destroyJobSystem();
+}
+
 TEST_CASE("Game Frame") {
 	size_t numWorkerThreads = 0;
 	Test   test;
@@ -369,6 +662,745 @@ TEST_CASE("Game Frame") {
 	destroyJobSystem();
 }
 
+TEST_CASE("Job pool overflow") {
+	constexpr size_t numJobsPerThread = 16;
+
+	JobSystemSettings settings;
+	settings.numJobsPerThread = numJobsPerThread;
+	settings.numWorkerThreads = 0;
+
+	SECTION("Fail") {
+		settings.jobPoolOverflowPolicy = JobPoolOverflowPolicy::fail;
+		initJobSystem(settings);
+
+		const JobId rootJob = createJob();
+		JobId       childJobs[numJobsPerThread - 1];
+		for (JobId& childJob : childJobs) {
+			childJob = createChildJob(rootJob);
+			CHECK(childJob != nullJobId);
+		}
+		CHECK(createChildJob(rootJob) == nullJobId);
+		for (JobId childJob : childJobs) {
+			startJob(childJob);
+		}
+		startAndWaitForJob(rootJob);
+		// Jobs are available again
+		CHECK(createJob() != nullJobId);
+
+		const ThreadStats stats = getThreadStats(0);
+#if TY_JS_PROFILE
+		CHECK(stats.maxLiveJobs == numJobsPerThread);
+#endif
+		CHECK(stats.numJobPoolOverflows == 1);
+	}
+	SECTION("Execute pending jobs") {
+		settings.jobPoolOverflowPolicy = JobPoolOverflowPolicy::executePendingJobs;
+		initJobSystem(settings);
+
+		std::atomic_store<size_t>(&completeCount, 0);
+		const JobId rootJob = createJob();
+		for (int i = 0; i < 100; ++i) {
+			startFunction(rootJob, [i]([[maybe_unused]] size_t threadIndex) { launchMissile(i, 0.f); });
+		}
+		startAndWaitForJob(rootJob);
+		CHECK(std::atomic_load(&completeCount) == 100);
+
+		const ThreadStats stats = getThreadStats(0);
+#if TY_JS_PROFILE
+		CHECK(stats.maxLiveJobs == numJobsPerThread);
+#endif
+		CHECK(stats.numJobPoolOverflows > 0);
+	}
+#ifndef _DEBUG
+	SECTION("Null job identifiers") {
+		// Null identifiers assert in debug builds, and are rejected in release builds
+		settings.jobPoolOverflowPolicy = JobPoolOverflowPolicy::executePendingJobs;
+		initJobSystem(settings);
+
+		const JobId rootJob = createJob();
+		JobId       childJobs[numJobsPerThread - 1];
+		for (JobId& childJob : childJobs) {
+			childJob = createChildJob(rootJob);
+		}
+		// No pending job to execute: the jobs in use have not been started
+		const JobId nullJob = createChildJob(rootJob);
+		CHECK(nullJob == nullJobId);
+		startJob(nullJob);
+		startJobs(&nullJob, 1);
+		CHECK(addContinuation(nullJob, [] {}) == nullJobId);
+		CHECK_FALSE(addDependency(nullJob, rootJob));
+		waitForJob(nullJob);
+		startJobs(childJobs, std::size(childJobs));
+		startAndWaitForJob(rootJob);
+		CHECK(createJob() != nullJobId);
+	}
+#endif
+
+	destroyJobSystem();
+}
+
+struct LargeJobArgs {
+	int values[60]; // too large to fit in a job
+};
+
+void sumLargeJobArgs(const JobParams& prm) {
+	const auto args = unpackJobArg<LargeJobArgs>(prm.args);
+	int        sum = 0;
+	for (int value : args.values) {
+		sum += value;
+	}
+	std::atomic_fetch_add<size_t>(&completeCount, static_cast<size_t>(sum));
+}
+
+TEST_CASE("Spilled job data") {
+	JobSystemSettings settings;
+	settings.spillBlocksPerThread = 8;
+
+	SECTION("Single Threaded") {
+		settings.numWorkerThreads = 0;
+	}
+	SECTION("Multi Threaded") {
+		settings.numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	}
+	initJobSystem(settings);
+
+	std::atomic_store<size_t>(&completeCount, 0);
+	LargeJobArgs args;
+	for (int i = 0; i < static_cast<int>(std::size(args.values)); ++i) {
+		args.values[i] = i;
+	}
+	constexpr int numJobs = 100;
+	const JobId   rootJob = createJob();
+	for (int i = 0; i < numJobs; ++i) {
+		startChildJob(rootJob, sumLargeJobArgs, args);
+	}
+	startAndWaitForJob(rootJob);
+	CHECK(std::atomic_load(&completeCount) == numJobs * (59 * 60 / 2));
+
+	destroyJobSystem();
+}
+
+TEST_CASE("Spill pool overflow") {
+	constexpr size_t numJobsPerThread = 16;
+
+	JobSystemSettings settings;
+	settings.numJobsPerThread = numJobsPerThread;
+	settings.numWorkerThreads = 0;
+	settings.spillBlocksPerThread = 1;
+	settings.jobPoolOverflowPolicy = JobPoolOverflowPolicy::executePendingJobs;
+	initJobSystem(settings);
+
+	std::atomic_store<size_t>(&completeCount, 0);
+	LargeJobArgs args;
+	for (int i = 0; i < static_cast<int>(std::size(args.values)); ++i) {
+		args.values[i] = i;
+	}
+	// The only spill block is used by a pending job
+	// Lambdas have no captures, so that with small jobs only the large jobs use spill blocks
+	static JobId precedingJob;
+	static JobId continuationJob;
+	precedingJob = createJob();
+	continuationJob = nullJobId;
+	const JobId rootJob = createJob();
+	startChildJob(rootJob, sumLargeJobArgs, args);
+	// All the jobs but one are in use. A pending job creates a continuation, taking the last job
+	JobId childJobs[numJobsPerThread - 5];
+	for (JobId& childJob : childJobs) {
+		childJob = createChildJob(rootJob, [] { std::atomic_fetch_add<size_t>(&completeCount, 1); });
+	}
+	startJob(createChildJob(rootJob, [] {
+		continuationJob = addContinuation(precedingJob, [] { std::atomic_fetch_add<size_t>(&completeCount, 1); });
+	}));
+	// Waits for the spill block, executing the pending jobs. The continuation must not get the job taken by this one
+	const JobId largeJob = createChildJob(rootJob, sumLargeJobArgs, args);
+	REQUIRE(largeJob != nullJobId);
+	startJob(largeJob);
+	startJobs(childJobs, std::size(childJobs));
+	startAndWaitForJob(rootJob);
+	REQUIRE(continuationJob != nullJobId);
+	startAndWaitForJob(precedingJob);
+	waitForJob(continuationJob);
+	CHECK(std::atomic_load(&completeCount) == 2 * (59 * 60 / 2) + std::size(childJobs) + 1);
+
+	destroyJobSystem();
+}
+
+TEST_CASE("Job priorities") {
+	JobSystemSettings settings;
+	SECTION("Single Threaded") {
+		settings.numWorkerThreads = 0;
+		settings.priorityStarvationLimit = 0;
+		initJobSystem(settings);
+
+		// Jobs of higher priority are executed first, whatever the order in which they are started
+		const JobPriority        priorities[] = { JobPriority::low, JobPriority::high, JobPriority::normal };
+		std::vector<JobPriority> order;
+		const JobId              rootJob = createJob();
+		for (int i = 0; i < 30; ++i) {
+			const JobPriority priority = priorities[i % std::size(priorities)];
+			startJob(createChildJob(rootJob, priority, [&order](JobPriority p) { order.push_back(p); }, priority));
+		}
+		startAndWaitForJob(rootJob);
+		CHECK(order.size() == 30);
+		CHECK(std::is_sorted(order.begin(), order.end()));
+		const ThreadStats stats = getThreadStats(0);
+		CHECK(stats.numExecutedJobsByPriority[static_cast<size_t>(JobPriority::high)] == 10);
+		CHECK(stats.numExecutedJobsByPriority[static_cast<size_t>(JobPriority::low)] == 10);
+		destroyJobSystem();
+	}
+	SECTION("Starvation") {
+		settings.numWorkerThreads = 0;
+		settings.priorityStarvationLimit = 4;
+		initJobSystem(settings);
+
+		// A low priority job is not delayed until all the high priority jobs are done
+		std::vector<JobPriority> order;
+		const JobId              rootJob = createJob(JobPriority::high);
+		startJob(createChildJob(rootJob, JobPriority::low, [&order] { order.push_back(JobPriority::low); }));
+		for (int i = 0; i < 30; ++i) {
+			// Child jobs inherit the priority of their parent
+			startJob(createChildJob(rootJob, [&order] { order.push_back(JobPriority::high); }));
+		}
+		startAndWaitForJob(rootJob);
+		const auto low = std::find(order.begin(), order.end(), JobPriority::low);
+		CHECK(low - order.begin() < static_cast<ptrdiff_t>(settings.priorityStarvationLimit));
+		destroyJobSystem();
+	}
+#if TY_JS_STEALING
+	SECTION("Starvation after idling") {
+		settings.numWorkerThreads = 1;
+		settings.priorityStarvationLimit = 16;
+		initJobSystem(settings);
+
+		// The worker searches for jobs while idle, then steals the root job and executes its children
+		// The searches that find no job do not count, so the low priority job is the last of the first priorityStarvationLimit jobs
+		std::vector<JobPriority> order;
+		std::atomic_size_t       executedCount = 0;
+		constexpr size_t         numJobs = 32;
+		JobId                    rootJob = nullJobId;
+		auto                     record = [&order, &executedCount](JobPriority priority) {
+            order.push_back(priority);
+            ++executedCount;
+		};
+		rootJob = createJob(JobPriority::high, [&rootJob, &record] {
+			startJob(createChildJob(rootJob, JobPriority::low, record, JobPriority::low));
+			for (size_t i = 1; i < numJobs; ++i) {
+				startJob(createChildJob(rootJob, record, JobPriority::high));
+			}
+		});
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		startJob(rootJob);
+		// This thread does not look for jobs, which are all executed by the worker
+		while (executedCount < numJobs) {
+			std::this_thread::yield();
+		}
+		waitForJob(rootJob);
+		REQUIRE(order.size() == numJobs);
+		const auto low = std::find(order.begin(), order.end(), JobPriority::low);
+		CHECK(low - order.begin() == static_cast<ptrdiff_t>(settings.priorityStarvationLimit) - 2);
+		destroyJobSystem();
+	}
+#endif
+	SECTION("Multi Threaded") {
+		settings.numWorkerThreads = std::thread::hardware_concurrency() - 1;
+		initJobSystem(settings);
+
+		std::atomic_store<size_t>(&completeCount, 0);
+		constexpr size_t numJobs = 3000;
+		const JobId      rootJob = createJob();
+		for (size_t i = 0; i < numJobs; ++i) {
+			startJob(createChildJob(rootJob, static_cast<JobPriority>(i % jobPriorityCount), [] { std::atomic_fetch_add<size_t>(&completeCount, 1); }));
+		}
+		startAndWaitForJob(rootJob);
+		CHECK(std::atomic_load(&completeCount) == numJobs);
+		destroyJobSystem();
+	}
+}
+
+#if TY_JS_STEALING
+// Background jobs are taken from other queues by background worker threads
+TEST_CASE("Background jobs") {
+	JobSystemSettings settings;
+	settings.numWorkerThreads = 0;
+	settings.numBackgroundThreads = 2;
+	initJobSystem(settings);
+	CHECK(getBackgroundThreadCount() == 2);
+
+	std::atomic_bool   frameJobDone { false };
+	std::atomic_bool   waitedForFrameJob { false };
+	std::atomic_size_t backgroundThread { 0 };
+	std::atomic_size_t continuationCount { 0 };
+	auto               load = [&] {
+		backgroundThread = getThisThreadIndex();
+		// Block until a frame job has run. This would never happen if the main thread executed this job
+		const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (! frameJobDone && std::chrono::steady_clock::now() < timeout) {
+			std::this_thread::yield();
+		}
+		waitedForFrameJob = frameJobDone.load();
+	};
+	const JobId loadJob = createJob(JobPriority::background, load);
+	const JobId uploadJob = addContinuation(loadJob, [&] { ++continuationCount; });
+	startJob(loadJob);
+	startAndWaitForJob(createJob([&] { frameJobDone = true; }));
+	waitForJob(loadJob);
+	waitForJob(uploadJob);
+	CHECK(waitedForFrameJob);
+	CHECK(backgroundThread > getWorkerThreadCount());
+	CHECK(continuationCount == 1);
+
+	destroyJobSystem();
+}
+
+// Continuations of background jobs run on the frame threads
+TEST_CASE("Continuations of background jobs") {
+	JobSystemSettings settings;
+	settings.numWorkerThreads = 1;
+	settings.numBackgroundThreads = 1;
+	initJobSystem(settings);
+	REQUIRE(getBackgroundThreadCount() == 1);
+
+	constexpr int numRuns = 100;
+	int           backgroundThreadErrors = 0;
+	int           continuationThreadErrors = 0;
+	for (int run = 0; run < numRuns; ++run) {
+		size_t      backgroundThread = 0;
+		size_t      continuationThread = 0;
+		const JobId loadJob = createJob(JobPriority::background, [&backgroundThread] { backgroundThread = getThisThreadIndex(); });
+		const JobId uploadJob = addContinuation(loadJob, [&continuationThread] { continuationThread = getThisThreadIndex(); });
+		startJob(loadJob);
+		waitForJob(uploadJob);
+		backgroundThreadErrors += backgroundThread <= getWorkerThreadCount();
+		continuationThreadErrors += continuationThread > getWorkerThreadCount();
+	}
+	CHECK(backgroundThreadErrors == 0);
+	CHECK(continuationThreadErrors == 0);
+	destroyJobSystem();
+}
+
+// Background jobs released into a full queue of a frame thread wait for room instead of being executed by the frame thread
+TEST_CASE("Queue overflow with background jobs") {
+	constexpr size_t numJobsPerThread = 16;
+	// Each dependent job takes two jobs from the pool of its creator, with its dependency
+	constexpr size_t numWorkerDependentJobs = 7;
+	constexpr size_t numMainDependentJobs = 6; // the pool also holds the root, predecessor and blocking jobs
+
+	JobSystemSettings settings;
+	settings.numJobsPerThread = numJobsPerThread;
+	settings.numWorkerThreads = 0;
+	settings.numBackgroundThreads = 2;
+	initJobSystem(settings);
+	REQUIRE(getBackgroundThreadCount() == 2);
+
+	std::atomic_int  frameThreadErrors = 0;
+	std::atomic_int  executedCount = 0;
+	std::atomic_int  blockedCount = 0;
+	std::atomic_bool release = false;
+	std::mutex       dependencyMutex;
+	const JobId      rootJob = createJob();
+	const JobId      predecessorJob = createJob([] {});
+	auto             addDependentJobs = [&](size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const JobId job = createChildJob(rootJob, JobPriority::background, [&frameThreadErrors, &executedCount] {
+                frameThreadErrors += getThisThreadIndex() <= getWorkerThreadCount();
+                ++executedCount;
+            });
+            addDependency(job, predecessorJob);
+        }
+	};
+	// Each background worker adds dependent jobs from its own pool, then blocks, so that the jobs fill the queue of this thread
+	auto blockBackgroundWorker = [&] {
+		{
+			std::lock_guard lock { dependencyMutex };
+			addDependentJobs(numWorkerDependentJobs);
+		}
+		++blockedCount;
+		const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while (! release && std::chrono::steady_clock::now() < timeout) {
+			std::this_thread::yield();
+		}
+	};
+	const JobId blockingJobs[] = { createJob(JobPriority::background, blockBackgroundWorker),
+		                           createJob(JobPriority::background, blockBackgroundWorker) };
+	startJobs(blockingJobs, std::size(blockingJobs));
+	while (blockedCount < 2) {
+		std::this_thread::yield();
+	}
+	addDependentJobs(numMainDependentJobs);
+	std::thread releaser { [&release] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		release = true;
+	} };
+	// The predecessor releases the dependent jobs, more than the queue of this thread can hold
+	startJob(predecessorJob);
+	startAndWaitForJob(rootJob);
+	releaser.join();
+	for (JobId job : blockingJobs) {
+		waitForJob(job);
+	}
+	CHECK(executedCount == static_cast<int>(numWorkerDependentJobs * 2 + numMainDependentJobs));
+	CHECK(frameThreadErrors == 0);
+	CHECK(getThreadStats(0).numQueueOverflows > 0);
+	destroyJobSystem();
+}
+#endif
+
+TEST_CASE("Thread pinning") {
+	JobSystemSettings settings;
+	settings.numWorkerThreads = 3;
+	settings.pinThreads = true;
+	SECTION("Default CPUs") {
+	}
+	SECTION("Chosen CPUs") {
+		settings.workerCpus = { 0, 0, 0 };
+	}
+	initJobSystem(settings);
+
+	std::atomic_store<size_t>(&completeCount, 0);
+	constexpr size_t numJobs = 2000;
+	const JobId      rootJob = createJob();
+	for (size_t i = 0; i < numJobs; ++i) {
+		startJob(createChildJob(rootJob, [] { std::atomic_fetch_add<size_t>(&completeCount, 1); }));
+	}
+	startAndWaitForJob(rootJob);
+	CHECK(std::atomic_load(&completeCount) == numJobs);
+#if TY_JS_STEALING
+	for (size_t i = 0; i <= getWorkerThreadCount(); ++i) {
+		const ThreadStats stats = getThreadStats(i);
+		size_t            stolenJobs = 0;
+		for (size_t count : stats.numStolenJobsByDistance) {
+			stolenJobs += count;
+		}
+		CHECK(stolenJobs == stats.numStolenJobs);
+	}
+#endif
+	destroyJobSystem();
+}
+
+TEST_CASE("Job pool memory") {
+	JobSystemSettings settings;
+	settings.numWorkerThreads = 3;
+	SECTION("Allocator") {
+		settings.jobPoolMemory = JobPoolMemory::allocator;
+	}
+	SECTION("Huge pages") {
+		settings.jobPoolMemory = JobPoolMemory::hugePages;
+	}
+	SECTION("Huge TLB pages") {
+		settings.jobPoolMemory = JobPoolMemory::hugeTlbPages;
+	}
+	size_t                   memory = 0;
+	const JobSystemAllocator allocator { trackingAlloc, trackingFree, &memory };
+	initJobSystem(settings, allocator);
+	// Huge pages fall back to the allocator if not available
+	CHECK(getJobPoolMemory() <= settings.jobPoolMemory);
+	print("Job pool memory: %d", static_cast<int>(getJobPoolMemory()));
+
+	std::atomic_store<size_t>(&completeCount, 0);
+	constexpr size_t numJobs = 2000;
+	const JobId      rootJob = createJob();
+	for (size_t i = 0; i < numJobs; ++i) {
+		startJob(createChildJob(rootJob, [] { std::atomic_fetch_add<size_t>(&completeCount, 1); }));
+	}
+	startAndWaitForJob(rootJob);
+	CHECK(std::atomic_load(&completeCount) == numJobs);
+	destroyJobSystem();
+	CHECK(memory == 0);
+}
+
+namespace {
+
+void recordGraphNode(const JobParams& prm) {
+	auto [executionOrder, executedNodeCount, node] = unpackJobArgs<std::atomic_size_t*, std::atomic_size_t*, size_t>(prm.args);
+	executionOrder[node] = (*executedNodeCount)++;
+}
+
+} // namespace
+
+TEST_CASE("Job graph") {
+	JobSystemSettings settings;
+	SECTION("Single Threaded") {
+		settings.numWorkerThreads = 0;
+	}
+	SECTION("Multi Threaded") {
+		settings.numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	}
+	SECTION("Small job pool") {
+		settings.numJobsPerThread = 8;
+		settings.numWorkerThreads = 3;
+	}
+	initJobSystem(settings);
+
+	// Layers of nodes, each depending on two nodes of the previous layer
+	constexpr size_t numLayers = 20;
+	constexpr size_t numNodesPerLayer = 16;
+	constexpr size_t numNodes = numLayers * numNodesPerLayer;
+
+	std::vector<std::atomic_size_t> executionOrder(numNodes);
+	std::atomic_size_t              executedNodeCount { 0 };
+
+	JobGraph graph;
+	for (size_t node = 0; node < numNodes; ++node) {
+		CHECK(graph.addNode(recordGraphNode, executionOrder.data(), &executedNodeCount, node) == node);
+	}
+	std::vector<std::pair<size_t, size_t>> edges;
+	for (size_t layer = 1; layer < numLayers; ++layer) {
+		for (size_t i = 0; i < numNodesPerLayer; ++i) {
+			const size_t node = layer * numNodesPerLayer + i;
+			edges.emplace_back(node - numNodesPerLayer, node);
+			edges.emplace_back(node - numNodesPerLayer + (i + 1) % numNodesPerLayer, node);
+		}
+	}
+	for (const auto& [predecessor, successor] : edges) {
+		graph.addEdge(static_cast<JobGraph::NodeId>(predecessor), static_cast<JobGraph::NodeId>(successor));
+	}
+	graph.compile();
+	CHECK(graph.isCompiled());
+	CHECK(graph.getNodeCount() == numNodes);
+
+	// Launch the same graph several times
+	for (int frame = 0; frame < 10; ++frame) {
+		executedNodeCount = 0;
+		startAndWaitForJob(createGraphJob(nullJobId, graph));
+		CHECK(executedNodeCount == numNodes);
+		const bool ordered = std::all_of(edges.begin(), edges.end(), [&executionOrder](const std::pair<size_t, size_t>& edge) {
+			return executionOrder[edge.first] < executionOrder[edge.second];
+		});
+		CHECK(ordered);
+	}
+
+	// A launch executes the graph job and at most one runner job per other thread, not one job per node
+	JobGraph wideGraph;
+	const JobGraph::NodeId wideRoot = wideGraph.addNode(recordGraphNode, executionOrder.data(), &executedNodeCount, size_t { 0 });
+	for (size_t node = 1; node < numNodes; ++node) {
+		wideGraph.addEdge(wideRoot, wideGraph.addNode(recordGraphNode, executionOrder.data(), &executedNodeCount, node));
+	}
+	wideGraph.compile();
+	auto executedJobCount = [] {
+		size_t count = 0;
+		for (size_t i = 0; i <= getWorkerThreadCount() + getBackgroundThreadCount(); ++i) {
+			count += getThreadStats(i).numExecutedJobs;
+		}
+		return count;
+	};
+	executedNodeCount = 0;
+	const size_t jobCountBefore = executedJobCount();
+	startAndWaitForJob(createGraphJob(nullJobId, wideGraph));
+	CHECK(executedNodeCount == numNodes);
+	CHECK(executedJobCount() - jobCountBefore <= 1 + getWorkerThreadCount());
+	destroyJobSystem();
+}
+
+TEST_CASE("Dependencies") {
+	JobSystemSettings settings;
+	SECTION("Single Threaded") {
+		settings.numWorkerThreads = 0;
+	}
+	SECTION("Multi Threaded") {
+		settings.numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	}
+	SECTION("Worker threads") {
+		settings.numWorkerThreads = 3;
+	}
+	initJobSystem(settings);
+
+	for (int frame = 0; frame < 100; ++frame) {
+		// render waits for physics and animation, and the frame waits for render
+		std::atomic_int  physicsCount { 0 };
+		std::atomic_int  animationCount { 0 };
+		std::atomic_bool renderedAfterSimulation { false };
+		constexpr int    numAnimationJobs = 20;
+
+		const JobId rootJob = createJob();
+		const JobId physicsJob = createChildJob(rootJob, [&physicsCount] { ++physicsCount; });
+		const JobId animationJob = createChildJob(rootJob);
+		JobId       animationJobs[numAnimationJobs];
+		for (JobId& job : animationJobs) {
+			job = createChildJob(animationJob, [&animationCount] { ++animationCount; });
+		}
+		const JobId renderJob = createChildJob(rootJob, [&] { renderedAfterSimulation = physicsCount == 1 && animationCount == numAnimationJobs; });
+		bool added = addDependency(renderJob, physicsJob) && addDependency(renderJob, animationJob);
+		// Each animation job is also a predecessor of render
+		for (JobId job : animationJobs) {
+			added = added && addDependency(renderJob, job);
+		}
+		CHECK(added);
+		startJob(physicsJob);
+		for (JobId job : animationJobs) {
+			startJob(job);
+		}
+		startJob(animationJob);
+		startAndWaitForJob(rootJob);
+		CHECK(renderedAfterSimulation);
+	}
+	destroyJobSystem();
+}
+
+TEST_CASE("Continuations") {
+	JobSystemSettings settings;
+	settings.numJobsPerThread = 4096;
+	settings.spillBlocksPerThread = 2048; // the lambdas of the chain may not fit in small jobs
+	SECTION("Single Threaded") {
+		settings.numWorkerThreads = 0;
+	}
+	SECTION("Multi Threaded") {
+		settings.numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	}
+	SECTION("Worker threads") {
+		settings.numWorkerThreads = 3;
+	}
+	initJobSystem(settings);
+	constexpr int numContinuations = 1000;
+
+	// Many continuations of the same job
+	std::atomic_int continuationCount { 0 };
+	const JobId     rootJob = createJob();
+	const JobId     job = createChildJob(rootJob);
+	for (int i = 0; i < numContinuations; ++i) {
+		addContinuation(job, [&continuationCount] { ++continuationCount; });
+	}
+	startJob(job);
+	startAndWaitForJob(rootJob);
+	CHECK(continuationCount == numContinuations);
+
+	// A chain of continuations, each one following the previous one
+	std::atomic_int chainLength { 0 };
+	std::atomic_int outOfOrderCount { 0 };
+	const JobId     chainRootJob = createJob();
+	const JobId     firstJob = createChildJob(chainRootJob);
+	JobId           lastJob = firstJob;
+	for (int i = 0; i < numContinuations; ++i) {
+		lastJob = addContinuation(lastJob, [&chainLength, &outOfOrderCount, i] {
+			if (chainLength++ != i) {
+				++outOfOrderCount;
+			}
+		});
+	}
+	startJob(firstJob);
+	startAndWaitForJob(chainRootJob);
+	CHECK(chainLength == numContinuations);
+	CHECK(outOfOrderCount == 0);
+	destroyJobSystem();
+}
+
+TEST_CASE("Job batches") {
+	JobSystemSettings settings;
+	SECTION("Single Threaded") {
+		settings.numWorkerThreads = 0;
+	}
+	SECTION("Multi Threaded") {
+		settings.numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	}
+	SECTION("Worker threads") {
+		settings.numWorkerThreads = 3;
+		settings.numBackgroundThreads = 1;
+	}
+	initJobSystem(settings);
+	constexpr int numJobs = 1000;
+
+	// Jobs of all priorities started at once
+	std::atomic_int executedCount { 0 };
+	const JobId     rootJob = createJob();
+	JobId           jobIds[jobPriorityCount * 10];
+	for (size_t i = 0; i < std::size(jobIds); ++i) {
+		const JobPriority priority = static_cast<JobPriority>(i % jobPriorityCount);
+		jobIds[i] = createChildJob(rootJob, priority, [&executedCount] { ++executedCount; });
+	}
+	startJobs(jobIds, std::size(jobIds));
+	startJobs(nullptr, 0);
+	startAndWaitForJob(rootJob);
+	CHECK(executedCount == static_cast<int>(std::size(jobIds)));
+
+	// A batch larger than its capacity, flushed when full and when destroyed
+	executedCount = 0;
+	const JobId batchRootJob = createJob();
+	{
+		JobBatch batch;
+		for (int i = 0; i < numJobs; ++i) {
+			batch.add(createChildJob(batchRootJob, [&executedCount] { ++executedCount; }));
+		}
+		batch.add(nullJobId);
+	}
+	startAndWaitForJob(batchRootJob);
+	CHECK(executedCount == numJobs);
+
+	// Children started in batches by a job
+	executedCount = 0;
+	const JobId parentJob = createJob();
+	startFunction(parentJob, [&executedCount, parentJob]([[maybe_unused]] size_t threadIndex) {
+		JobBatch batch;
+		for (int i = 0; i < numJobs; ++i) {
+			batch.add(createChildJob(parentJob, [&executedCount] { ++executedCount; }));
+			if (i % 100 == 99) {
+				batch.flush();
+			}
+		}
+	});
+	startAndWaitForJob(parentJob);
+	CHECK(executedCount == numJobs);
+
+	// An empty batch can be destroyed by a thread without a queue
+	std::thread { [] {
+		JobBatch batch;
+		batch.flush();
+	} }.join();
+	destroyJobSystem();
+}
+
+TEST_CASE("Wait from any thread") {
+	JobSystemSettings settings;
+	SECTION("Single Threaded") {
+		settings.numWorkerThreads = 0;
+	}
+	SECTION("Multi Threaded") {
+		settings.numWorkerThreads = std::thread::hardware_concurrency() - 1;
+	}
+	SECTION("Worker threads") {
+		settings.numWorkerThreads = 3;
+	}
+	initJobSystem(settings);
+	constexpr int numFrames = 50;
+	constexpr int numJobs = 100;
+	constexpr int numWaiters = 3;
+
+	int failedWaitCount = 0;
+	for (int frame = 0; frame < numFrames; ++frame) {
+		std::atomic_int executedCount { 0 };
+		std::atomic_int failedCount { 0 };
+		const JobId     rootJob = createJob();
+		for (int i = 0; i < numJobs; ++i) {
+			startJob(createChildJob(rootJob, [&executedCount] { ++executedCount; }));
+		}
+		// A job waiting for a job created by another thread
+		std::atomic_bool otherJobExecuted { false };
+		const JobId      otherJob = createChildJob(rootJob, [&otherJobExecuted] { otherJobExecuted = true; });
+		startJob(otherJob);
+		startFunction(rootJob, [otherJob, &otherJobExecuted, &failedCount]([[maybe_unused]] size_t threadIndex) {
+			waitForJob(otherJob);
+			if (! otherJobExecuted) {
+				++failedCount;
+			}
+		});
+		// External threads waiting for the frame
+		std::thread waiters[numWaiters];
+		for (std::thread& waiter : waiters) {
+			waiter = std::thread { [rootJob, &executedCount, &failedCount] {
+				waitForJob(rootJob);
+				if (executedCount != numJobs) {
+					++failedCount;
+				}
+			} };
+		}
+		startAndWaitForJob(rootJob);
+		for (std::thread& waiter : waiters) {
+			waiter.join();
+		}
+		failedWaitCount += failedCount;
+	}
+	CHECK(failedWaitCount == 0);
+	destroyJobSystem();
+}
+
 int main(int argc, char* argv[]) {
 	return Catch::Session().run(argc, argv);
 }